@@ -0,0 +1,49 @@
+# avr.mk - run the firmware in simavr and measure the cycles of the tasks and interrupt handlers
+#
+# Part of dcfclock
+#
+# (c) David Haworth
+#
+# dcfclock is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dcfclock is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+#
+# dcfclock is an Arduino sketch, written for an Arduino Nano
+
+# Included after Arduino.make, which builds the firmware ($(TARGET_ELF)). avr/avrbench.c is built
+# for the host against simavr and libelf, and runs each scenario on the firmware. The output is a
+# tab-separated table like those of "make host-bench": worst-case and mean cycles per task and per
+# interrupt handler, to compare between builds.
+
+AVR_BUILD      = avr/build
+AVR_ELF       ?= $(TARGET_ELF)
+AVR_NM        ?= $(AVR_TOOLS_PATH)/avr-nm
+SIMAVR_CFLAGS ?= $(shell pkg-config --cflags simavr 2>/dev/null || echo -I/usr/include/simavr)
+SIMAVR_LIBS   ?= $(shell pkg-config --libs simavr 2>/dev/null || echo -lsimavr) -lelf
+AVR_SCENARIOS  = idle dcf modes setting
+
+.PHONY: avr-bench avr-clean
+
+avr-bench: $(AVR_BUILD)/avrbench $(AVR_BUILD)/$(TARGET).sym
+	@$(AVR_BUILD)/avrbench -h
+	@for s in $(AVR_SCENARIOS); do $(AVR_BUILD)/avrbench $(AVR_ELF) $(AVR_BUILD)/$(TARGET).sym $$s || exit 1; done
+
+avr-clean:
+	rm -rf $(AVR_BUILD)
+
+$(AVR_BUILD)/$(TARGET).sym: $(AVR_ELF)
+	@mkdir -p $(AVR_BUILD)
+	$(AVR_NM) -C $< > $@
+
+$(AVR_BUILD)/avrbench: avr/avrbench.c
+	@mkdir -p $(AVR_BUILD)
+	$(CC) -O2 -g -Wall -std=gnu99 $(SIMAVR_CFLAGS) -o $@ $< $(SIMAVR_LIBS)
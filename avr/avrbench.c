@@ -0,0 +1,441 @@
+/* avrbench.c - cycle counts of the tasks and interrupt handlers, measured in simavr
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_cycle_timers.h"
+#include "avr_ioport.h"
+#include "avr_uart.h"
+
+/* Usage: avrbench -h						print the table header
+ *        avrbench FIRMWARE.elf SYMBOLS SCENARIO	run a scenario and print one row per task and interrupt
+ *
+ * SYMBOLS is the output of "avr-nm -C" for the firmware. The firmware runs on a simulated atmega328p
+ * at 16 MHz. The inputs are driven by cycle timers, so they're on time even while the CPU sleeps:
+ * 50 Hz on T1 for the time base, the DCF receiver on INT0 and the buttons.
+ *
+ * A task or handler is timed from its first instruction to the ret/reti that takes the stack pointer
+ * back above its entry value. Interrupts that occur during a task are counted separately and not
+ * included in the task's cycles. The 7 cycles of the interrupt response and the jmp in the vector
+ * table aren't included either.
+*/
+
+#define F_CPU			16000000UL
+#define MS(x)			((avr_cycle_count_t)(x) * (F_CPU / 1000))
+
+// Nano pins: DCF input D2 (INT0), DCF PON D4, mains D5 (T1), Up D6, Down D7, Mode D8
+#define PIN_DCF			'D', 2
+#define PIN_MAINS		'D', 5
+#define PIN_UP			'D', 6
+#define PIN_DOWN		'D', 7
+#define PIN_MODE		'B', 0
+
+#define MAX_FUNCS		40
+#define MAX_DEPTH		8
+#define MAX_EVENTS		2048
+
+typedef struct
+{
+	char name[32];
+	const char *kind;				// "task" or "isr"
+	avr_flashaddr_t addr;			// Byte address of the first instruction
+	unsigned long n;
+	avr_cycle_count_t min, max, sum;
+} func_t;
+
+typedef struct
+{
+	int f;
+	uint16_t sp;					// Stack pointer at the first instruction
+	avr_cycle_count_t start;
+	avr_cycle_count_t nested;		// Cycles spent in interrupts while this one was running
+} frame_t;
+
+typedef struct
+{
+	avr_cycle_count_t t;
+	char port;
+	int pin;
+	int level;
+} event_t;
+
+// The tasks in dcfclock.cpp's task list
+static const char *const tasks[] =
+{	"DisplayDriver", "Timekeeper", "DcfDecoder", "Button", "Telemetry", "Console", NULL
+};
+
+// atmega328p interrupt vectors
+static const char *const vectors[] =
+{	"RESET", "INT0", "INT1", "PCINT0", "PCINT1", "PCINT2", "WDT", "TIMER2_COMPA", "TIMER2_COMPB",
+	"TIMER2_OVF", "TIMER1_CAPT", "TIMER1_COMPA", "TIMER1_COMPB", "TIMER1_OVF", "TIMER0_COMPA",
+	"TIMER0_COMPB", "TIMER0_OVF", "SPI_STC", "USART_RX", "USART_UDRE", "USART_TX", "ADC", "EE_READY",
+	"ANALOG_COMP", "TWI", "SPM_READY"
+};
+
+#define N_VECTORS		(sizeof(vectors)/sizeof(vectors[0]))
+
+static func_t funcs[MAX_FUNCS];
+static int nfuncs;
+static frame_t stack[MAX_DEPTH];
+static int depth;
+static event_t events[MAX_EVENTS];
+static int nevents;
+static int next_event;
+static int mains_level;
+
+// add_func() - add a task or handler at addr to the table
+static void add_func(const char *name, const char *kind, unsigned long addr)
+{
+	if ( nfuncs >= MAX_FUNCS )
+		return;
+	func_t *f = &funcs[nfuncs++];
+	snprintf(f->name, sizeof(f->name), "%s", name);
+	f->kind = kind;
+	f->addr = addr;
+	f->n = 0;
+	f->min = ~(avr_cycle_count_t)0;
+	f->max = 0;
+	f->sum = 0;
+}
+
+// read_symbols() - find the tasks and the interrupt handlers in the output of avr-nm -C
+static void read_symbols(const char *file)
+{
+	FILE *fp = fopen(file, "r");
+	char line[256];
+
+	if ( fp == NULL )
+	{
+		perror(file);
+		exit(2);
+	}
+
+	while ( fgets(line, sizeof(line), fp) != NULL )
+	{
+		unsigned long addr;
+		char type;
+		char name[200];
+		int v;
+
+		if ( sscanf(line, "%lx %c %199[^\n]", &addr, &type, name) != 3 || (type != 'T' && type != 't') )
+			continue;
+
+		if ( sscanf(name, "__vector_%d", &v) == 1 && v > 0 && v < (int)N_VECTORS )
+		{
+			add_func(vectors[v], "isr", addr);
+			continue;
+		}
+
+		char *paren = strchr(name, '(');
+		if ( paren != NULL )
+			*paren = '\0';
+		for ( int i = 0; tasks[i] != NULL; i++ )
+		{
+			if ( strcmp(name, tasks[i]) == 0 )
+				add_func(name, "task", addr);
+		}
+	}
+	fclose(fp);
+
+	if ( nfuncs == 0 )
+	{
+		fprintf(stderr, "%s: no tasks or interrupt handlers found\n", file);
+		exit(2);
+	}
+}
+
+static int find_func(avr_flashaddr_t pc)
+{
+	for ( int i = 0; i < nfuncs; i++ )
+	{
+		if ( funcs[i].addr == pc )
+			return i;
+	}
+	return -1;
+}
+
+static uint16_t get_sp(avr_t *avr)
+{
+	return avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+}
+
+/* The scenarios
+*/
+static void add_event(avr_cycle_count_t t, char port, int pin, int level)
+{
+	if ( nevents >= MAX_EVENTS )
+	{
+		fprintf(stderr, "avrbench: too many events\n");
+		exit(2);
+	}
+	events[nevents].t = t;
+	events[nevents].port = port;
+	events[nevents].pin = pin;
+	events[nevents].level = level;
+	nevents++;
+}
+
+static int cmp_event(const void *a, const void *b)
+{
+	const event_t *ea = a, *eb = b;
+	return ( ea->t < eb->t ) ? -1 : ( ea->t > eb->t );
+}
+
+// press() - press a button (active low) at t ms for len ms
+static void press(char port, int pin, unsigned t, unsigned len)
+{
+	add_event(MS(t), port, pin, 0);
+	add_event(MS(t + len), port, pin, 1);
+}
+
+// bcd() - put v into n bits of a DCF frame, starting at bit first
+static void bcd(char *b, int first, int n, int v)
+{
+	int x = ((v / 10) << 4) | (v % 10);
+	for ( int i = 0; i < n; i++ )
+		b[first + i] = (x >> i) & 1;
+}
+
+static char parity(const char *b, int first, int end)
+{
+	char p = 0;
+	for ( int i = first; i < end; i++ )
+		p ^= b[i];
+	return p;
+}
+
+// dcf_frame() - the frame for hh:mm on Sunday 2024-03-10, CET
+static void dcf_frame(char *b, int h, int mi)
+{
+	memset(b, 0, 59);
+	b[18] = 1;						// Z2: CET
+	b[20] = 1;						// S: start of time
+	bcd(b, 21, 7, mi);
+	b[28] = parity(b, 21, 28);
+	bcd(b, 29, 6, h);
+	b[35] = parity(b, 29, 35);
+	bcd(b, 36, 6, 10);
+	bcd(b, 42, 3, 7);
+	bcd(b, 45, 5, 3);
+	bcd(b, 50, 8, 24);
+	b[58] = parity(b, 36, 58);
+}
+
+// dcf() - send n minutes of DCF signal from t ms, starting at second 50 of the minute before 10:00
+// A pulse is high for 100 ms (0) or 200 ms (1). Second 59 has no pulse.
+static void dcf(unsigned t, int n)
+{
+	char b[59];
+
+	for ( int s = 50; s < 59; s++ )
+	{
+		add_event(MS(t + (s - 50) * 1000), PIN_DCF, 1);
+		add_event(MS(t + (s - 50) * 1000 + 100), PIN_DCF, 0);
+	}
+	t += 10000;
+
+	for ( int m = 0; m < n; m++ )
+	{
+		dcf_frame(b, 10, m + 1);	// Sent during the minute before the time it gives
+		for ( int s = 0; s < 59; s++ )
+		{
+			add_event(MS(t + s * 1000), PIN_DCF, 1);
+			add_event(MS(t + s * 1000 + (b[s] ? 200 : 100)), PIN_DCF, 0);
+		}
+		t += 60000;
+	}
+}
+
+// scenario() - set up the inputs for a scenario and return its length in cycles, or 0 if it's unknown
+static avr_cycle_count_t scenario(const char *name)
+{
+	if ( strcmp(name, "idle") == 0 )
+		return MS(10000);
+
+	if ( strcmp(name, "dcf") == 0 )
+	{
+		dcf(1500, 3);
+		return MS(1500 + 10000 + 3 * 60000 + 1000);
+	}
+
+	if ( strcmp(name, "modes") == 0 )
+	{
+		// hh:mm, mm:ss, DDMM, YYYY, test, hh:mm, mm:ss
+		for ( int i = 0; i < 6; i++ )
+			press(PIN_MODE, 2000 + i * 1500, 100);
+		return MS(2000 + 6 * 1500 + 6000);
+	}
+
+	if ( strcmp(name, "setting") == 0 )
+	{
+		press(PIN_MODE, 2000, 600);		// Mode+Down: enter setting state
+		press(PIN_DOWN, 2200, 200);
+		press(PIN_UP, 3500, 100);
+		press(PIN_UP, 4500, 2000);		// Auto-repeat
+		press(PIN_MODE, 7500, 100);		// Next digit
+		press(PIN_DOWN, 8500, 100);
+		press(PIN_MODE, 9500, 600);		// Mode+Down: set the time
+		press(PIN_DOWN, 9700, 200);
+		return MS(12000);
+	}
+
+	return 0;
+}
+
+/* Input drivers
+*/
+static void set_pin(avr_t *avr, char port, int pin, int level)
+{
+	avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(port), pin), level);
+}
+
+static avr_cycle_count_t mains_timer(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+	mains_level = !mains_level;
+	set_pin(avr, PIN_MAINS, mains_level);
+	return when + MS(10);
+}
+
+static avr_cycle_count_t event_timer(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+	while ( next_event < nevents && events[next_event].t <= when )
+	{
+		event_t *e = &events[next_event++];
+		set_pin(avr, e->port, e->pin, e->level);
+	}
+	return ( next_event < nevents ) ? events[next_event].t : 0;
+}
+
+int main(int argc, char **argv)
+{
+	if ( argc == 2 && strcmp(argv[1], "-h") == 0 )
+	{
+		printf("scenario\tfunction\tkind\tcount\tmin\tmax\tmean\n");
+		return 0;
+	}
+	if ( argc != 4 )
+	{
+		fprintf(stderr, "usage: avrbench -h | avrbench FIRMWARE.elf SYMBOLS SCENARIO\n");
+		return 2;
+	}
+
+	read_symbols(argv[2]);
+	avr_cycle_count_t end = scenario(argv[3]);
+	if ( end == 0 )
+	{
+		fprintf(stderr, "avrbench: unknown scenario %s\n", argv[3]);
+		return 2;
+	}
+	qsort(events, nevents, sizeof(events[0]), cmp_event);
+
+	elf_firmware_t fw;
+	memset(&fw, 0, sizeof(fw));
+	if ( elf_read_firmware(argv[1], &fw) != 0 )
+	{
+		fprintf(stderr, "avrbench: can't read %s\n", argv[1]);
+		return 2;
+	}
+	strcpy(fw.mmcu, "atmega328p");
+	fw.frequency = F_CPU;
+
+	avr_t *avr = avr_make_mcu_by_name(fw.mmcu);
+	if ( avr == NULL )
+	{
+		fprintf(stderr, "avrbench: simavr has no %s\n", fw.mmcu);
+		return 2;
+	}
+	avr_init(avr);
+	avr_load_firmware(avr, &fw);
+
+	// The serial output is binary telemetry: keep it off stdout
+	uint32_t flags = 0;
+	avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+	flags &= ~AVR_UART_FLAG_STDIO;
+	avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+
+	// Buttons released, no DCF pulse
+	set_pin(avr, PIN_MODE, 1);
+	set_pin(avr, PIN_UP, 1);
+	set_pin(avr, PIN_DOWN, 1);
+	set_pin(avr, PIN_DCF, 0);
+	avr_cycle_timer_register(avr, MS(10), mains_timer, NULL);
+	if ( nevents > 0 )
+		avr_cycle_timer_register(avr, events[0].t, event_timer, NULL);
+
+	avr_flashaddr_t last_pc = ~(avr_flashaddr_t)0;
+
+	while ( avr->cycle < end )
+	{
+		if ( avr->pc != last_pc )
+		{
+			int f = find_func(avr->pc);
+			if ( f >= 0 && depth < MAX_DEPTH )
+			{
+				stack[depth].f = f;
+				stack[depth].sp = get_sp(avr);
+				stack[depth].start = avr->cycle;
+				stack[depth].nested = 0;
+				depth++;
+			}
+		}
+		last_pc = avr->pc;
+
+		int state = avr_run(avr);
+		if ( state == cpu_Done || state == cpu_Crashed )
+		{
+			fprintf(stderr, "avrbench: %s: the CPU stopped at pc 0x%04x, cycle %llu\n", argv[3],
+				(unsigned)avr->pc, (unsigned long long)avr->cycle);
+			return 1;
+		}
+
+		uint16_t sp = get_sp(avr);
+		while ( depth > 0 && sp > stack[depth-1].sp )
+		{
+			frame_t *fr = &stack[--depth];
+			func_t *f = &funcs[fr->f];
+			avr_cycle_count_t total = avr->cycle - fr->start;
+			avr_cycle_count_t own = total - fr->nested;
+
+			f->n++;
+			f->sum += own;
+			if ( own < f->min )
+				f->min = own;
+			if ( own > f->max )
+				f->max = own;
+			if ( depth > 0 )
+				stack[depth-1].nested += total;
+		}
+	}
+
+	for ( int i = 0; i < nfuncs; i++ )
+	{
+		func_t *f = &funcs[i];
+		if ( f->n > 0 )
+			printf("%s\t%s\t%s\t%lu\t%llu\t%llu\t%llu\n", argv[3], f->name, f->kind, f->n,
+				(unsigned long long)f->min, (unsigned long long)f->max, (unsigned long long)(f->sum / f->n));
+	}
+
+	avr_terminate(avr);
+	return 0;
+}
@@ -19,164 +19,410 @@
  *
  * dcfclock is an Arduino sketch, written for an Arduino Nano
 */
+#include <avr/pgmspace.h>
 #include "dcfclock.h"
+#include "fastpin.h"
 #include "button.h"
 #include "displaydriver.h"
 #include "timekeeper.h"
 #include "setting.h"
+#include "telemetry.h"
+#include "console.h"
 
 #define SCAN_INTERVAL	Ticks(20)
+#define DEBOUNCE_TIME	Ticks(40)		// A new level must be stable for this long
+#define IDLE_INTERVAL	Ticks(60000)	// Fallback when waiting for a pin-change interrupt
 
-#define OneSecond		Ticks(1000)/SCAN_INTERVAL
-#define NORMAL_TIMEOUT	(OneSecond * 5)
-#define SETTING_TIMEOUT	(OneSecond * 10)
+#define INIT_TIMEOUT	Ticks(1000)
+#define NORMAL_TIMEOUT	Ticks(5000)
+#define SETTING_TIMEOUT	Ticks(10000)
 
-#define ModeBtn			8
-#define UpBtn			6
-#define DownBtn			7
+// Auto-repeat of Up and Down in setting state. Each repeat is a quarter faster than the one before.
+#define REPEAT_DELAY	Ticks(600)		// Hold this long before the first repeat
+#define REPEAT_START	Ticks(240)		// First repeat interval
+#define REPEAT_MIN		Ticks(60)		// Fastest repeat interval
+#define REPEAT_WHOLE	4				// From this repeat onwards, step the whole value
+
+typedef FastPin<8> ModeBtn;
+typedef FastPin<6> UpBtn;
+typedef FastPin<7> DownBtn;
 
 // Button states - so it's possible to translate a mix of n/c and n/o switches
 #define PRESSED			1
 #define RELEASED		0
 
-// Previous values of the buttons
-static char mode_btn_prev = RELEASED;
-static char up_btn_prev = RELEASED;
-static char down_btn_prev = RELEASED;
-static int timeout_counter;
+// Gesture timing
+#define LONG_TIME		Ticks(1000)		// Held on its own at least this long: long press
+#define DOUBLE_TIME		Ticks(400)		// Second press within this time after release: double press
+
+// Raw levels (bit mask), the time they last changed, and the debounced levels
+#define BTN_MODE		0x01
+#define BTN_UP			0x02
+#define BTN_DOWN		0x04
+static unsigned char btn_raw;
+static unsigned long btn_raw_time;
+static unsigned char btn_state;
+unsigned long btn_event_time;			// ReadTime() of the latest debounced press or release
+
+static task_t *btntask;
+
+void check_timeout(void);
+void start_timeout(unsigned long t);
+void check_repeat(char up);
+void toggle_state(void);
+void toggle_setting(void);
+void advance_mode(void);
+static unsigned char bound(unsigned char buttons, unsigned char g);
+static unsigned char dispatch(unsigned char buttons, unsigned char g);
+
+// Gestures
+#define G_PRESS			0		// Pressed (when no other button is held)
+#define G_SHORT			1		// Released, not part of a chord or long press (or double press if bound)
+#define G_LONG			2		// Held on its own for LONG_TIME
+#define G_DOUBLE		3		// Pressed again within DOUBLE_TIME of a short press
+#define G_CHORD			4		// Pressed while the button that started the gesture is held (see CHORD())
+#define G_HELD			5		// Held on its own (every scan, until a long press is recognised)
 
-#if DBG
-static char mode_btn_dbg = RELEASED;
-static char up_btn_dbg = RELEASED;
-static char down_btn_dbg = RELEASED;
+// States in which a binding applies (1 << state)
+#define S_NORMAL		(1 << (state_normal >> 4))
+#define S_OFF			(1 << (state_off >> 4))
+#define S_SETTING		(1 << (state_setting >> 4))
+#define S_ANY			(S_NORMAL | S_OFF | S_SETTING)
 
-#define DBG_PRINT(x)	Serial.println(x)
+// A chord is bound to the button that started the gesture and the one pressed while it's held,
+// so Mode then Up is a chord but Up then Mode is not.
+#define CHORD(first, then)	(((first) << 4) | (then))
 
-void btn_debug(char m, char u, char d)
+typedef struct
 {
-	if ( m != mode_btn_dbg )
-	{
-		mode_btn_dbg = m;
-		DBG_PRINT(m == PRESSED ? "mode PRESSED" : "mode RELEASED");
-	}
+	unsigned char buttons;		// BTN_xxx, or CHORD() for G_CHORD
+	unsigned char gesture;		// G_xxx
+	unsigned char states;		// S_xxx mask
+	void (*action)(void);
+} binding_t;
 
-	if ( u != up_btn_dbg )
-	{
-		up_btn_dbg = u;
-		DBG_PRINT(u == PRESSED ? "up PRESSED" : "up RELEASED");
-	}
+static void repeat_up(void)		{ check_repeat(1); }
+static void repeat_down(void)	{ check_repeat(0); }
 
-	if ( d != down_btn_dbg )
-	{
-		down_btn_dbg = d;
-		DBG_PRINT(d == PRESSED ? "down PRESSED" : "down RELEASED");
-	}
-}
+#if HOST_SIM
+// The clock has no use for long or double presses yet. In the host build they're bound to Down in
+// normal state, which the clock doesn't use, so that host/test_gesture.cpp can check them.
+unsigned btn_test_short, btn_test_long, btn_test_double;
+static void test_short(void)	{ btn_test_short++; }
+static void test_long(void)		{ btn_test_long++; }
+static void test_double(void)	{ btn_test_double++; }
+#endif
 
-#else
-#define DBG_PRINT(x)		do { } while (0)
-#define btn_debug(m, u, d)	do { } while (0)
+// The first matching binding is used
+static const binding_t bindings[] PROGMEM =
+{	{	CHORD(BTN_MODE, BTN_UP),	G_CHORD,	S_ANY,			toggle_state	},
+	{	CHORD(BTN_MODE, BTN_DOWN),	G_CHORD,	S_ANY,			toggle_setting	},
+	{	BTN_MODE,				G_SHORT,	S_SETTING,			advance_setting	},
+	{	BTN_MODE,				G_SHORT,	S_NORMAL | S_OFF,	advance_mode	},
+	{	BTN_UP,					G_PRESS,	S_SETTING,			increase_digit	},
+	{	BTN_DOWN,				G_PRESS,	S_SETTING,			decrease_digit	},
+	{	BTN_UP,					G_HELD,		S_SETTING,			repeat_up		},
+	{	BTN_DOWN,				G_HELD,		S_SETTING,			repeat_down		},
+#if HOST_SIM
+	{	BTN_DOWN,				G_SHORT,	S_NORMAL,			test_short		},
+	{	BTN_DOWN,				G_LONG,		S_NORMAL,			test_long		},
+	{	BTN_DOWN,				G_DOUBLE,	S_NORMAL,			test_double		},
 #endif
+};
 
-void check_timeout(void);
-void toggle_state(void);
-void toggle_setting(void);
-void advance_mode(void);
+#define N_BINDINGS		(sizeof(bindings)/sizeof(bindings[0]))
+
+// Gesture recogniser state
+static unsigned char g_prev;			// Debounced state at the previous scan
+static unsigned char g_btn;				// Button that started the current gesture
+static unsigned long g_time;			// ... and when it was pressed
+static unsigned char g_used;			// The current gesture has already produced its event
+static unsigned char g_pending;			// Button of a short press that might become a double press
+static unsigned long g_pending_time;	// ... and when it was released
+
+static unsigned char timeout_active;
+static unsigned long timeout_time;		// ReadTime() at which the timeout expires
+
+static unsigned long repeat_time;		// ReadTime() of the next repeat
+static unsigned repeat_interval;
+static unsigned char repeat_count;
+
+static unsigned char btn_dbg;
+
+#define DBG_UI(code)	TLM_LOG(LOG_BUTTON, LOG_INFO, TLM_UI, (code))
+
+static void btn_debug(unsigned char state)
+{
+	if ( LOG_BUTTON >= LOG_DEBUG && state != btn_dbg )
+	{
+		btn_dbg = state;
+		TLM_LOG(LOG_BUTTON, LOG_DEBUG, TLM_BUTTON, state);
+	}
+}
 
 void ButtonInit(task_t *buttonTask)
 {
+	btntask = buttonTask;				// Remember this for the pin-change interrupts
 	buttonTask->timer = SCAN_INTERVAL;
 
-	pinMode(ModeBtn, INPUT_PULLUP);
-	pinMode(UpBtn, INPUT_PULLUP);
-	pinMode(DownBtn, INPUT_PULLUP);
+	ModeBtn::input_pullup();
+	UpBtn::input_pullup();
+	DownBtn::input_pullup();
 
-	timeout_counter = OneSecond;		// Switch to normal hhmm mode after 1 sec
+	// Any change on a button pin wakes the task
+	ModeBtn::pcint_enable();
+	UpBtn::pcint_enable();
+	DownBtn::pcint_enable();
+
+	start_timeout(INIT_TIMEOUT);		// Switch to normal hhmm mode after 1 sec
 }
 
-void Button(task_t *buttonTask, unsigned long elapsed)
+// Pin change on one of the buttons: start debouncing at once
+ISR(PCINT0_vect)
 {
-	buttonTask->timer += SCAN_INTERVAL;
+	taskerNotify(btntask);
+}
 
-	// Read all the buttons
-	char mode_btn_new =	( digitalRead(ModeBtn) == HIGH ) ? RELEASED : PRESSED;
-	char up_btn_new =	( digitalRead(UpBtn) == HIGH )   ? RELEASED : PRESSED;
-	char down_btn_new =	( digitalRead(DownBtn) == HIGH ) ? RELEASED : PRESSED;
+ISR(PCINT2_vect)
+{
+	taskerNotify(btntask);
+}
+
+// btn_debounce() - read the buttons and return the levels that have been stable for DEBOUNCE_TIME
+static unsigned char btn_debounce(void)
+{
+	unsigned long now = ReadTime();
+	unsigned char raw = 0;
 
-	btn_debug(mode_btn_new, up_btn_new, down_btn_new);
+	if ( !ModeBtn::read() )
+		raw |= BTN_MODE;
+	if ( !UpBtn::read() )
+		raw |= BTN_UP;
+	if ( !DownBtn::read() )
+		raw |= BTN_DOWN;
 
-	if ( mode_btn_new == RELEASED && up_btn_new == RELEASED && down_btn_new == RELEASED )
+	if ( raw != btn_raw )
 	{
-		// No buttons pressed; on timeout, return to base state.
-		check_timeout();
+		btn_raw = raw;
+		btn_raw_time = now;
 	}
-	else
+	else if ( raw != btn_state && (now - btn_raw_time) >= DEBOUNCE_TIME )
 	{
-		if ( mode_btn_new == PRESSED )
+		btn_state = raw;
+		btn_event_time = now;
+	}
+
+	return btn_state;
+}
+
+// gesture() - recognise gestures in the debounced button state and run the bound actions
+static void gesture(unsigned char state, unsigned long now)
+{
+	unsigned char pressed = state & ~g_prev;
+	unsigned char released = g_prev & ~state;
+	g_prev = state;
+
+	if ( pressed != 0 )
+	{
+		if ( state == pressed )
 		{
-			if ( up_btn_new == PRESSED && up_btn_prev == RELEASED )
-			{
-				// Mode held and up button newly pressed
-				// Toggle between normal and off state, or leave the setting state without change.
-				toggle_state();
-			}
-			else if ( down_btn_new == PRESSED && down_btn_prev == RELEASED )
+			// First button of a new gesture
+			repeat_count = 0;
+			if ( g_pending == pressed && (now - g_pending_time) <= DOUBLE_TIME )
 			{
-				// Mode held and down button newly pressed
-				// Enter/leave setting state (set time on leaving)
-				toggle_setting();
-			}
-			else if ( mode_btn_prev == RELEASED )
-			{
-				// Mode button newly pressed on its own
-				// Advannce to next mode or digit
-				if ( (display_mode & 0xf0) == state_setting )
-				{
-					// Advance to next digit in setting mode
-					advance_setting();
-				}
-				else
-				{
-					// Advance to next mode
-					advance_mode();
-				}
+				g_pending = 0;
+				g_btn = pressed;
+				g_time = now;
+				g_used = dispatch(pressed, G_DOUBLE);
+				return;
 			}
+
+			if ( g_pending != 0 )
+				dispatch(g_pending, G_SHORT);	// A different button: the earlier press was single
+			g_pending = 0;
+
+			g_btn = pressed;
+			g_time = now;
+			g_used = 0;
+			dispatch(pressed, G_PRESS);
 		}
-		else if ( up_btn_new == PRESSED && up_btn_prev == RELEASED )
+		else if ( g_btn != 0 && dispatch(CHORD(g_btn, pressed), G_CHORD) )
 		{
-			if ( (display_mode & 0xf0) == state_setting )
-				increase_digit();
+			// Pressed while the first button is held
+			g_used = 1;
 		}
-		else if ( down_btn_new == PRESSED && down_btn_prev == RELEASED )
+		else
 		{
-			if ( (display_mode & 0xf0) == state_setting )
-				decrease_digit();
+			// Not a chord: the newly pressed button starts a gesture of its own
+			repeat_count = 0;
+			g_btn = pressed;
+			g_time = now;
+			g_used = 0;
+			dispatch(pressed, G_PRESS);
 		}
+		return;
+	}
 
-		if ( (display_mode & 0xf0) == state_setting )
+	if ( released != 0 )
+	{
+		if ( (released & g_btn) != 0 )
 		{
-			timeout_counter = SETTING_TIMEOUT;
+			// Gesture complete
+			if ( !g_used )
+			{
+				if ( bound(g_btn, G_DOUBLE) )
+				{
+					g_pending = g_btn;			// Wait to see if it's a double press
+					g_pending_time = now;
+				}
+				else
+					dispatch(g_btn, G_SHORT);
+			}
+			g_btn = 0;
 		}
+		return;
+	}
+
+	if ( state != 0 && state == g_btn )
+	{
+		// Held on its own
+		if ( !g_used && (now - g_time) >= LONG_TIME && dispatch(g_btn, G_LONG) )
+			g_used = 1;
+		if ( !g_used )
+			dispatch(g_btn, G_HELD);
+	}
+	else if ( g_pending != 0 && (now - g_pending_time) > DOUBLE_TIME )
+	{
+		dispatch(g_pending, G_SHORT);
+		g_pending = 0;
+	}
+}
+
+// find_binding() - return the action for the gesture in the current state, or 0 if there's none
+// The table is in flash.
+static void (*find_binding(unsigned char buttons, unsigned char g))(void)
+{
+	unsigned char st = 1 << (display_mode >> 4);
+	binding_t b;
+
+	for ( unsigned char i = 0; i < N_BINDINGS; i++ )
+	{
+		memcpy_P(&b, &bindings[i], sizeof(b));
+		if ( b.buttons == buttons && b.gesture == g && (b.states & st) != 0 )
+			return b.action;
+	}
+	return 0;
+}
+
+// bound() - return 1 if there's an action for the gesture in the current state
+static unsigned char bound(unsigned char buttons, unsigned char g)
+{
+	return find_binding(buttons, g) != 0;
+}
+
+// dispatch() - run the action bound to the gesture in the current state. Returns 1 if there was one.
+static unsigned char dispatch(unsigned char buttons, unsigned char g)
+{
+	void (*action)(void) = find_binding(buttons, g);
+
+	if ( action == 0 )
+		return 0;
+	action();
+	return 1;
+}
+
+// Button() - runs every SCAN_INTERVAL while a button is pressed or changing, a timeout is running
+// or a double press might still come. Otherwise it waits for a pin-change interrupt.
+void Button(task_t *buttonTask, unsigned long elapsed)
+{
+	unsigned long now = ReadTime();
+	unsigned char state = btn_debounce();
+
+	btn_debug(state);
+
+	gesture(state, now);
+
+	if ( state == 0 )
+	{
+		// No buttons pressed; on timeout, return to base state.
+		check_timeout();
+	}
+	else if ( (display_mode & 0xf0) == state_setting )
+	{
+		// The timeout runs from the last time a button was seen pressed
+		start_timeout(SETTING_TIMEOUT);
+	}
+	else
+	{
+		start_timeout(NORMAL_TIMEOUT);
+	}
+
+	if ( btn_state != 0 || btn_raw != btn_state || timeout_active || g_pending != 0 )
+		buttonTask->timer += SCAN_INTERVAL;
+	else
+		buttonTask->timer += IDLE_INTERVAL;
+
+	// Show the effect of a button at once rather than on the next second tick
+	if ( update_time || display_change )
+		display_notify();
+}
+
+// start_timeout() - (re)start the timeout to expire t ticks from now
+void start_timeout(unsigned long t)
+{
+	timeout_time = ReadTime() + t;
+	timeout_active = 1;
+}
+
+// check_repeat() - auto-repeat a held Up or Down button in setting state
+// The first few repeats step the digit; after that the whole value is stepped at the digit's place.
+void check_repeat(char up)
+{
+	unsigned long now = ReadTime();
+
+	if ( repeat_count == 0 )
+	{
+		// First call since the press: the first repeat comes REPEAT_DELAY after the press
+		repeat_time = btn_event_time + REPEAT_DELAY;
+		repeat_interval = REPEAT_START;
+		repeat_count = 1;
+	}
+
+	if ( (long)(now - repeat_time) < 0 )
+		return;
+
+	if ( repeat_count <= REPEAT_WHOLE )
+	{
+		if ( up )
+			increase_digit();
 		else
-		{
-			timeout_counter = NORMAL_TIMEOUT;
-		}
+			decrease_digit();
 	}
+	else
+		step_value(up ? 1 : -1);
+
+	if ( repeat_count < 255 )
+		repeat_count++;
 
-	mode_btn_prev = mode_btn_new;
-	up_btn_prev = up_btn_new;
-	down_btn_prev = down_btn_new;
+	repeat_time += repeat_interval;
+	if ( (long)(now - repeat_time) >= 0 )
+		repeat_time = now + repeat_interval;	// Don't try to catch up after a late scan
+	repeat_interval -= repeat_interval / 4;
+	if ( repeat_interval < REPEAT_MIN )
+		repeat_interval = REPEAT_MIN;
 }
 
 // check_timeout() - check for a timeout and revert to previous running state
 void check_timeout(void)
 {
 	// No buttons pressed; on timeout, return to base state.
-	if ( timeout_counter > 0 )
+	repeat_count = 0;
+	if ( timeout_active )
 	{
-		timeout_counter--;
-		if ( timeout_counter <= 0 )
+		if ( (long)(ReadTime() - timeout_time) >= 0 )
 		{
+			timeout_active = 0;
+
 			// If the display isn't showing normal hh:mm, clear it.
 			// Among other things, this clears out any unnecessary punctuation.
 			if ( display_mode != ( state_normal | mode_hhmm ) )
@@ -191,12 +437,12 @@ void check_timeout(void)
 			unsigned char state = display_mode & 0xf0;
 			if ( state == state_off )
 			{
-				DBG_PRINT("Revert to off state");
+				DBG_UI(TlmUi_RevertOff);
 				display_mode = state_off | mode_xxx;
 			}
 			else
 			{
-				DBG_PRINT("Revert to normal state");
+				DBG_UI(TlmUi_RevertNormal);
 				if ( state == state_setting )
 					dps_off();
 				display_mode = state_normal | mode_hhmm;
@@ -216,7 +462,7 @@ void toggle_state(void)
 	unsigned char state = display_mode & 0xf0;
 	if ( state == state_normal )
 	{
-		DBG_PRINT("Switch to off state");
+		DBG_UI(TlmUi_SwitchOff);
 		display_mode = state_off | mode_xxx;
 		// Blank the display
 		setdigit(0, 0x00);
@@ -230,7 +476,7 @@ void toggle_state(void)
 	{
 		if ( state == state_setting )
 			dps_off();
-		DBG_PRINT("Switch to normal state");
+		DBG_UI(TlmUi_SwitchNormal);
 		display_mode = state_normal | mode_hhmm;
 		update_time = 1;
 	}
@@ -243,12 +489,12 @@ void toggle_setting(void)
 	// Enter/leave setting state (set time on leaving)
 	if ( (display_mode & 0xf0) == state_setting )
 	{
-		DBG_PRINT("Leave setting");
+		DBG_UI(TlmUi_LeaveSetting);
 		leave_setting();
 	}
 	else
 	{
-		DBG_PRINT("Enter setting");
+		DBG_UI(TlmUi_EnterSetting);
 		enter_setting();
 	}
 }
@@ -256,28 +502,29 @@ void toggle_setting(void)
 // advance_mode() - change to next mode in sequence
 void advance_mode(void)
 {
-	DBG_PRINT("mode++");
+	DBG_UI(TlmUi_ModeNext);
 	unsigned char mode = display_mode & 0x0f;
+
+	select_mode(( mode >= mode_xxx ) ? mode_hhmm : mode + 1);
+}
+
+// select_mode() - change to the given mode in the current state (normal or off, not setting)
+void select_mode(unsigned char mode)
+{
+	unsigned char old = display_mode & 0x0f;
 	unsigned char state = display_mode & 0xf0;
 
-	if ( mode >= mode_xxx )
+	display_mode = state | mode;
+	if ( display_mode == ( state_normal | mode_xxx ) )
 	{
-		display_mode = state | mode_hhmm;
-		blank();	// Clear out the junk from test mode
+		// All LEDs on. Colon will blink.
+		allon();
+		console_stats();
 	}
-	else
+	else if ( mode == mode_xxx || old == mode_xxx )
 	{
-		display_mode++;
-		if ( display_mode == ( state_normal | mode_xxx ) )
-		{
-			// All LEDs on. Colon will blink.
-			allon();
-		}
-		else if ( display_mode == ( state_off | mode_xxx ) )
-		{
-			// Blank the display
-			blank();
-		}
+		// Blank the display (off), or clear out the junk from test mode
+		blank();
 	}
 	update_time = 1;
 }
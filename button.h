@@ -29,4 +29,8 @@
 void ButtonInit(task_t *);
 void Button(task_t *, unsigned long elapsed);
 
+extern unsigned long btn_event_time;	// ReadTime() of the latest debounced press or release
+
+extern void select_mode(unsigned char mode);
+
 #endif
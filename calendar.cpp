@@ -0,0 +1,124 @@
+/* calendar.cpp - constant-time calendar conversions
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <avr/pgmspace.h>
+#include "calendar.h"
+
+// No. of days before the start of each month, for normal (l = 0) and leap (l = 1) years.
+// Entry 12 is the length of the year.
+#define CUMDAYS(l)	{	0, 31, 59+(l), 90+(l), 120+(l), 151+(l), 181+(l),	\
+						212+(l), 243+(l), 273+(l), 304+(l), 334+(l), 365+(l) }
+
+static const unsigned cumdays[2][13] PROGMEM = { CUMDAYS(0), CUMDAYS(1) };
+
+// No. of leap years from year 1 to year y-1
+#define LEAPS_BEFORE(y)	((long)((y)-1)/4 - (long)((y)-1)/100 + (long)((y)-1)/400)
+
+#define DAYS_PER_400Y	146097L
+#define EPOCH_DOW		6		// 2000-01-01 was a Saturday
+
+static inline unsigned cumday(char leap, unsigned char m)
+{
+	return pgm_read_word(&cumdays[(unsigned char)leap][m]);
+}
+
+// isleap() - return 1 if y is a leap year
+char isleap(unsigned y)
+{
+	if ( (y % 4) == 0 )
+	{
+		if ( (y % 100) == 0 )
+		{
+			if ( (y % 400) == 0 )
+				return 1;
+			return 0;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+// monthlength() - return the no. of days in month m (0..11) of year y
+unsigned char monthlength(unsigned char m, unsigned y)
+{
+	char l = isleap(y);
+	return cumday(l, m+1) - cumday(l, m);
+}
+
+// date_to_yday() - return the day of the year (0..365) of a date
+unsigned date_to_yday(unsigned y, unsigned char month, unsigned char day)
+{
+	return cumday(isleap(y), month - 1) + day - 1;
+}
+
+// yday_to_date() - convert a day of the year to month and day of the month
+// No month is shorter than 28 days, so yday/32 is either the right month or one too small.
+void yday_to_date(unsigned y, unsigned yday, unsigned char *month, unsigned char *day)
+{
+	char l = isleap(y);
+	unsigned char m = yday >> 5;
+
+	if ( yday >= cumday(l, m+1) )
+		m++;
+
+	*month = m + 1;
+	*day = yday - cumday(l, m) + 1;
+}
+
+// days_since_epoch() - return the day number of 1st January of year y
+long days_since_epoch(unsigned y)
+{
+	return 365L * ((long)y - CAL_EPOCH_YEAR) + LEAPS_BEFORE(y) - LEAPS_BEFORE(CAL_EPOCH_YEAR);
+}
+
+// epoch_days_to_year() - convert a day number to the year and day of the year
+// The estimate from the average length of a year is at most one year out.
+void epoch_days_to_year(long dayno, unsigned *years, unsigned *yday)
+{
+	long n = dayno * 400;
+	if ( n < 0 )
+		n -= DAYS_PER_400Y - 1;			// Round towards minus infinity
+	unsigned y = CAL_EPOCH_YEAR + n / DAYS_PER_400Y;
+
+	long start = days_since_epoch(y);
+	if ( start > dayno )
+	{
+		y--;
+		start = days_since_epoch(y);
+	}
+	else if ( dayno - start >= 365 + isleap(y) )
+	{
+		start += 365 + isleap(y);
+		y++;
+	}
+
+	*years = y;
+	*yday = dayno - start;
+}
+
+// day_of_week() - return the day of the week of a day number. Monday = 1 .. Sunday = 7
+unsigned char day_of_week(long dayno)
+{
+	long d = (dayno + EPOCH_DOW - 1) % 7;
+	if ( d < 0 )
+		d += 7;
+	return d + 1;
+}
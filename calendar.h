@@ -0,0 +1,40 @@
+/* calendar.h - constant-time calendar conversions
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#ifndef CALENDAR_H
+#define CALENDAR_H	1
+
+// Day numbers count from 2000-01-01 (day 0). Earlier dates have negative day numbers.
+// Months are 1..12, days of the month 1..31 and days of the year 0..365.
+#define CAL_EPOCH_YEAR	2000
+
+extern char isleap(unsigned years);
+extern unsigned char monthlength(unsigned char m, unsigned years);	// m is 0..11
+
+extern unsigned date_to_yday(unsigned years, unsigned char month, unsigned char day);
+extern void yday_to_date(unsigned years, unsigned yday, unsigned char *month, unsigned char *day);
+
+extern long days_since_epoch(unsigned years);
+extern void epoch_days_to_year(long dayno, unsigned *years, unsigned *yday);
+
+extern unsigned char day_of_week(long dayno);	// Monday = 1 .. Sunday = 7, as in DCF77
+
+#endif
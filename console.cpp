@@ -0,0 +1,288 @@
+/* console.cpp - line-oriented command console on the serial port
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include "dcfclock.h"
+#include "tasker.h"
+#include "timekeeper.h"
+#include "displaydriver.h"
+#include "dcfdecoder.h"
+#include "button.h"
+#include "telemetry.h"
+#include "console.h"
+
+#define CON_INTERVAL	Ticks(100)		// Poll the UART this often
+#define CON_MAXBYTES	16				// Max. no. of bytes to take from the UART per run
+#define CON_LINELEN		32				// Longest command line (longer lines are rejected)
+#define CON_REPLYROOM	TLM_TEXT_ROOM(80)	// Don't start a reply until the telemetry ring has this much room
+
+static char conLine[CON_LINELEN+1];
+static unsigned char conLen;
+static unsigned char conReady;			// 1 when conLine holds a complete command
+static unsigned char conOverflow;		// 1 if the current line is too long
+static unsigned char conStats;			// Next task whose statistics are to be printed, plus 1 (0: none)
+
+static void con_execute(char *p);
+static void con_time(void);
+static void con_set(const char *p);
+static void con_mode(const char *p);
+static void con_dcf(const char *p);
+static const char *con_word(const char *p, const char *w);
+static const char *con_number(const char *p, unsigned *v);
+static void con_print2(unsigned char v);
+
+void ConsoleInit(task_t *consoleTask)
+{
+	consoleTask->timer = CON_INTERVAL;
+	conLen = 0;
+	conReady = 0;
+	conOverflow = 0;
+	conStats = 0;
+}
+
+// Console() - collect a command line a few bytes at a time and run it when it's complete
+// At most one command is executed per run, and only when the telemetry ring has room for its reply.
+// The task statistics are printed one task per run.
+void Console(task_t *consoleTask, unsigned long elapsed)
+{
+	consoleTask->timer += CON_INTERVAL;
+
+	if ( conStats != 0 || conReady )
+	{
+		if ( tlm_room() < CON_REPLYROOM )
+			return;								// Try again next time
+	}
+
+	if ( conStats != 0 )
+	{
+		if ( PrintTaskStats(conStats - 1) )
+			conStats++;
+		else
+			conStats = 0;
+		return;									// The next command waits until all the rows are out
+	}
+
+	if ( conReady )
+	{
+		con_execute(conLine);
+		conReady = 0;
+		conLen = 0;
+	}
+
+	for ( unsigned char n = 0; n < CON_MAXBYTES && Serial.available() > 0; n++ )
+	{
+		char c = Serial.read();
+
+		if ( c == '\r' || c == '\n' )
+		{
+			if ( conOverflow )
+			{
+				conOverflow = 0;
+				conLen = 0;						// Rejected with "?"
+			}
+			else if ( conLen == 0 )
+				continue;						// Blank line, or the LF of a CRLF
+			conLine[conLen] = '\0';
+			conReady = 1;
+			break;								// The rest waits until the command has been executed
+		}
+		else if ( conLen < CON_LINELEN )
+			conLine[conLen++] = c;
+		else
+			conOverflow = 1;
+	}
+}
+
+// con_execute() - decode and run a command line
+static void con_execute(char *p)
+{
+	const char *q;
+
+	while ( *p == ' ' )
+		p++;
+
+	if ( (q = con_word(p, PSTR("time"))) != 0 )
+		con_time();
+	else if ( (q = con_word(p, PSTR("set"))) != 0 )
+		con_set(q);
+	else if ( (q = con_word(p, PSTR("mode"))) != 0 )
+		con_mode(q);
+	else if ( (q = con_word(p, PSTR("stats"))) != 0 )
+	{
+#if TASKER_STATS
+		console_stats();
+#else
+		tlmText.print(F("stats disabled (TASKER_STATS 0)\r\n"));
+#endif
+	}
+	else if ( (q = con_word(p, PSTR("dcf"))) != 0 )
+		con_dcf(q);
+	else
+		tlmText.print(F("?\r\n"));
+}
+
+// console_stats() - print the task statistics, starting at the next run of the console task
+void console_stats(void)
+{
+	conStats = 1;
+}
+
+// con_time() - print the date and time as YYYY-MM-DD hh:mm:ss
+static void con_time(void)
+{
+	datetime_t dt;
+	unsigned char secs, month, day;
+
+	breaktime(getepoch(), &dt, &secs);		// One reading, so the seconds match the minutes
+	yday_to_date(dt.years, dt.days, &month, &day);
+
+	tlmText.print(dt.years);
+	tlmText.print('-');
+	con_print2(month);
+	tlmText.print('-');
+	con_print2(day);
+	tlmText.print(' ');
+	con_print2(dt.hours);
+	tlmText.print(':');
+	con_print2(dt.mins);
+	tlmText.print(':');
+	con_print2(secs);
+	tlmText.print(F("\r\n"));
+}
+
+// con_set() - set YYYY-MM-DD hh:mm
+static void con_set(const char *p)
+{
+	unsigned y, mo, d, h, mi;
+
+	if ( (p = con_number(p, &y)) == 0 || *p++ != '-' ||
+		 (p = con_number(p, &mo)) == 0 || *p++ != '-' ||
+		 (p = con_number(p, &d)) == 0 || *p++ != ' ' ||
+		 (p = con_number(p, &h)) == 0 || *p++ != ':' ||
+		 (p = con_number(p, &mi)) == 0 || *p != '\0' ||
+		 y < CAL_EPOCH_YEAR || y > 2099 || mo < 1 || mo > 12 ||
+		 d < 1 || d > monthlength(mo - 1, y) || h > 23 || mi > 59 )
+	{
+		tlmText.print(F("usage: set YYYY-MM-DD hh:mm\r\n"));
+		return;
+	}
+
+	datetime_t dt;
+	dt.years = y;
+	dt.days = date_to_yday(y, mo, d);
+	dt.hours = h;
+	dt.mins = mi;
+	settime(&dt);
+	update_time = 1;
+	display_notify();
+	con_time();
+}
+
+// con_mode() - select a display mode in the current state, as the Mode button does
+static void con_mode(const char *p)
+{
+	unsigned m;
+
+	if ( (p = con_number(p, &m)) == 0 || *p != '\0' || m > mode_xxx )
+	{
+		tlmText.print(F("usage: mode 0..4\r\n"));
+		return;
+	}
+
+	if ( (display_mode & 0xf0) == state_setting )
+	{
+		tlmText.print(F("setting in progress\r\n"));
+		return;
+	}
+
+	select_mode(m);
+	display_notify();
+	tlmText.print(F("ok\r\n"));
+}
+
+// con_dcf() - feed synthetic pulses to the DCF frame decoder
+static void con_dcf(const char *p)
+{
+	const char *q;
+
+	for ( q = p; *q != '\0'; q++ )
+	{
+		if ( *q != '0' && *q != '1' && *q != 'm' && *q != ' ' )
+		{
+			tlmText.print(F("usage: dcf [01m]...\r\n"));
+			return;
+		}
+	}
+
+	for ( q = p; *q != '\0'; q++ )
+	{
+		if ( *q != ' ' )
+			DcfInject(*q);
+	}
+
+	tlmText.print(F("bit "));
+	tlmText.print((unsigned)bitNo);
+	tlmText.print(F(" conf "));
+	tlmText.print((unsigned)dcfConfidence);
+	tlmText.print(F("\r\n"));
+}
+
+// con_word() - if p starts with the word w (in flash), return the start of the arguments, else 0
+static const char *con_word(const char *p, const char *w)
+{
+	unsigned char n = strlen_P(w);
+
+	if ( strncmp_P(p, w, n) != 0 )
+		return 0;
+	p += n;
+	if ( *p != '\0' && *p != ' ' )
+		return 0;
+	while ( *p == ' ' )
+		p++;
+	return p;
+}
+
+// con_number() - read a decimal number. Returns a pointer to the next character, or 0 if there isn't a number.
+static const char *con_number(const char *p, unsigned *v)
+{
+	if ( *p < '0' || *p > '9' )
+		return 0;
+
+	*v = 0;
+	while ( *p >= '0' && *p <= '9' )
+	{
+		unsigned char digit = *p++ - '0';
+
+		if ( *v > 6553 || (*v == 6553 && digit > 5) )
+			return 0;							// Doesn't fit in 16 bits
+		*v = *v * 10 + digit;
+	}
+	return p;
+}
+
+// con_print2() - print a number in two digits with a leading zero
+static void con_print2(unsigned char v)
+{
+	if ( v < 10 )
+		tlmText.print('0');
+	tlmText.print((unsigned)v);
+}
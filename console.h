@@ -0,0 +1,46 @@
+/* console.h - line-oriented command console on the serial port
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#ifndef CONSOLE_H
+#define CONSOLE_H	1
+
+#include "tasker.h"
+
+/* Commands (one per line, terminated by CR or LF):
+ *	time					print the date and time
+ *	set YYYY-MM-DD hh:mm	set the date and time (seconds = 0)
+ *	mode N					select display mode N (0..4, see mode_xxx in displaydriver.h), as the Mode button does.
+ *							Not in setting state.
+ *	stats					print the task statistics (only if built with TASKER_STATS)
+ *	dcf PULSES				feed pulses to the DCF frame decoder: 0, 1 or m (minute mark).
+ *							A frame can be spread over several lines.
+ *
+ * The replies are sent as TLM_TEXT telemetry records; tools/tlmdecode.py shows them as text.
+*/
+
+/* Tasker init- and run functions
+*/
+void ConsoleInit(task_t *);
+void Console(task_t *, unsigned long elapsed);
+
+extern void console_stats(void);
+
+#endif
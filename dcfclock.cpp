@@ -27,21 +27,20 @@
 #include "displaydriver.h"
 #include "button.h"
 #include "dcfdecoder.h"
+#include "telemetry.h"
+#include "console.h"
 
 // Task list
-#define NTASKS	4
+#define NTASKS	6
 task_t taskList[NTASKS] =
 {	{	DisplayDriverInit,	DisplayDriver,	0	},
 	{	TimekeeperInit,		Timekeeper,		0	},
 	{	DcfDecoderInit,		DcfDecoder,		0	},
-	{	ButtonInit,			Button,			0	}
+	{	ButtonInit,			Button,			0	},
+	{	TelemetryInit,		Telemetry,		0	},
+	{	ConsoleInit,		Console,		0	}
 };
 
-// TCNT1 modes
-#define FREQ_TCCR1B_EXT_RISING	0x07
-#define FREQ_TCCR1B_EXT_FALLING	0x06
-
-
 // setup() - standard Arduino startup function
 // Everything happens in here
 void setup(void)
@@ -49,22 +48,16 @@ void setup(void)
 	taskerSetup(taskList, NTASKS);
 
 	Serial.begin(115200);				// Start the serial port.
-	Serial.println("dcfclock v0.2");
-	Serial.println("GPLv3 or later; see source for details");
-
-	// Clear all the settings of timer 1
-	TCCR1A = 0;
-	TCCR1B = 0;
-
-	// Select external input as frequency source.
-    // 7 for rising edge, 6 for falling edge.
-    // All waveform generation functions are disabled (also in TCCR1A).
-    TCCR1B = FREQ_TCCR1B_EXT_RISING;
+	tlmText.println(F("dcfclock v0.2"));	// Waits in the telemetry ring until the tasks run
+	tlmText.println(F("GPLv3 or later; see source for details"));
 
-    // Clear the counter
-    TCNT1 = 0;
+	TimebaseInit();
 
-	taskerRun(taskList, NTASKS, ReadTime);
+#if SleepWhenIdle
+	taskerRun(taskList, NTASKS, ReadTime, IdleSleep);
+#else
+	taskerRun(taskList, NTASKS, ReadTime, 0);
+#endif
 }
 
 // loop() - standard Arduino run function (not used)
@@ -72,12 +65,15 @@ void loop(void)
 {
 }
 
-// Time function for the tasker module
-unsigned ReadTime(void)
+// Print the statistics of task i as telemetry text. Returns 0 if there's no task i.
+unsigned char PrintTaskStats(unsigned char i)
 {
-#if TimeSource == Time_millis
-	return (unsigned)millis();
-#else
-	return (unsigned)TCNT1;
+#if TASKER_STATS
+	if ( i < NTASKS )
+	{
+		taskerPrintStats(tlmText, taskList, i);
+		return 1;
+	}
 #endif
+	return 0;
 }
@@ -38,8 +38,28 @@
 #define Ticks(x)	((x)/10)
 #endif
 
-extern unsigned ReadTime(void);
+// Sleep between task deadlines instead of polling ReadTime() continuously.
+#define SleepWhenIdle	1
+
+extern void TimebaseInit(void);
+extern unsigned long ReadTime(void);
+extern void IdleSleep(unsigned long wakeTime);
+extern unsigned char PrintTaskStats(unsigned char i);
 
 #define DBG		1
 
+// Telemetry levels. Each module sends the records at or below its level; the calls for the
+// other records compile to nothing.
+#define LOG_OFF			0
+#define LOG_INFO		1		// State changes, DCF frame results
+#define LOG_DEBUG		2		// Every button change
+
+#if DBG
+#define LOG_BUTTON		LOG_DEBUG
+#define LOG_DCF			LOG_INFO
+#else
+#define LOG_BUTTON		LOG_OFF
+#define LOG_DCF			LOG_OFF
+#endif
+
 #endif
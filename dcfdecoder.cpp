@@ -23,83 +23,270 @@
 */
 #include <Arduino.h>
 #include "dcfclock.h"
+#include "fastpin.h"
 #include "tasker.h"
 #include "displaydriver.h"
+#include "timekeeper.h"
+#include "dcfdecoder.h"
+#include "telemetry.h"
 
-#define DcfInputPin		2			// DCF receiver output connected to this (must be an INT pin)
-#define DcfPonPin		4			// DCF receiver PON input connected to this
+typedef FastPin<2> DcfInputPin;		// DCF receiver output connected to this (must be an INT pin)
+typedef FastPin<4> DcfPonPin;		// DCF receiver PON input connected to this
 
 #define DcfPonInterval	Ticks(1100)	// 1.1 seconds
 #define DcfInterval		Ticks(100)	// 0.1 seconds
 
-#define DcfMinSync		Ticks(1900)	// 1.9 seconds
-#define DcfMaxSync		Ticks(2200)	// 2.2 seconds
-#define DcfDebounce		Ticks(60)
-#define DcfMin0			Ticks(80)	// Pulse width 100 ms +/- 20 --> 0
-#define DcfMax0			Ticks(120)
-#define DcfMin1			Ticks(180)	// Pulse width 200 ms +/- 20 --> 1
-#define DcfMax1			Ticks(220)
+// Demodulators
+#define DcfDemod_Edge		0		// Measure the pulse widths between timestamped edges
+#define DcfDemod_Correlate	1		// Sample the input and correlate over many seconds (noisy reception)
+
+#ifndef DcfDemod
+#define DcfDemod		DcfDemod_Edge
+#endif
+
+// Correlating demodulator: one sample per 20 ms, so 50 bins per second.
+// The first 100 ms of a second (window A) contains a pulse in every second except 59.
+// The second 100 ms (window B) is high for a 1 and low for a 0.
+#define DcfSampleInterval	Ticks(20)
+#define DcfBins			50
+#define DcfBinsA		5
+#define DcfBinsB		5
+#define DcfMinContrast	(DcfBinsA*62)	// Minimum edge score (a quarter of full scale) for lock
+
+// Edges are timestamped by timer 2, independent of the mains tick.
+// Timer 2 counts at 16 MHz/1024 = 64 us; the overflow interrupt extends it to 32 bits (DcfReadTime()).
+#define DcfTicks(x)		((unsigned)((x)*1000UL/64))
+typedef unsigned long dcftime_t;		// 64 us ticks; wraps after about 76 hours
+
+#define DcfMinSync		DcfTicks(1900)	// 1.9 seconds
+#define DcfMaxSync		DcfTicks(2200)	// 2.2 seconds
+#define DcfDebounce		DcfTicks(60)
+#define DcfMin0			DcfTicks(80)	// Pulse width 100 ms +/- 20 --> 0
+#define DcfMax0			DcfTicks(120)
+#define DcfMin1			DcfTicks(180)	// Pulse width 200 ms +/- 20 --> 1
+#define DcfMax1			DcfTicks(220)
+#define DcfMinSec		DcfTicks(900)	// Leading edge to leading edge 1 second +/- 100 ms
+#define DcfMaxSec		DcfTicks(1100)
+
+// Bit numbers in the frame (see README.md)
+#define DcfFrameBits	59
+#define DcfBit_M		0		// Start of minute, always 0
+#define DcfBit_Z1		17		// CEST
+#define DcfBit_Z2		18		// CET
+#define DcfBit_S		20		// Start of time, always 1
+#define DcfBit_Min		21
+#define DcfBit_P1		28
+#define DcfBit_Hour		29
+#define DcfBit_P2		35
+#define DcfBit_Day		36
+#define DcfBit_Dow		42
+#define DcfBit_Month	45
+#define DcfBit_Year		50
+#define DcfBit_P3		58
+
+// Consensus between frames
+#define DcfAgreeFast	2		// Agreeing frames needed for the first synchronisation
+#define DcfAgreeFull	3		// Agreeing frames needed to move a synchronised clock by more than DcfMaxStep
+#define DcfMaxStep		5		// Seconds that a single frame can move a synchronised clock
 
 #define DcfState_0		0		// Seen 0
 #define DcfState_1		1		// Seen 1
 #define DcfState_Sync	2		// Waiting for end-of-minute marker
 #define	DcfState_Pon	3		// Power-on interval
+#define DcfState_Rx		4		// Receiving a frame (correlating demodulator)
+
+#if DcfDemod == DcfDemod_Edge
+// Queue of edges from the interrupt handler to the decoder task.
+// Single producer (the ISR) and single consumer (the task): the ISR only writes dcfQHead,
+// the task only writes dcfQTail, so no interrupt lock is needed.
+#define DcfQueueLen		8			// Must be a power of 2
+#define DcfQueueMask	(DcfQueueLen-1)
+
+typedef struct
+{
+	dcftime_t time;					// DcfReadTime() at the edge
+	unsigned char level;			// Pin state after the edge
+} dcfedge_t;
+
+static volatile dcfedge_t dcfQueue[DcfQueueLen];
+static volatile unsigned char dcfQHead;
+static volatile unsigned char dcfQTail;
+static volatile unsigned char dcfQOverflow;	// No. of edges lost because the queue was full (wraps)
+static volatile unsigned long dcfTimeHigh;	// Upper 24 bits of the edge time base
+static dcftime_t dcfTickTime;			// Time of the timekeeper's last second tick
+#else
+static unsigned char dcfAcc[DcfBins];	// Average input level at each position in the second
+static unsigned char dcfBin;			// Position of the current sample in the second
+static unsigned char dcfPhase;			// Position at which the second starts
+static unsigned char dcfCountA;			// No. of high samples in window A
+static unsigned char dcfCountB;			// No. of high samples in window B
+static unsigned char dcfWeakConf;		// Confidence of the least reliable bit in the frame ...
+static unsigned char dcfWeakBit;		// ... and its bit number
+static unsigned char dcfTickBin;		// Position in the second of the timekeeper's last second tick
+#endif
 
 unsigned char dcfState;
-unsigned char dcfPulse;
 unsigned char bitNo;
-unsigned leadingTime;
-
-static void DcfInterruptHandler(void);	// Formard
+dcftime_t leadingTime;
+unsigned char dcfShiftReg[8];
+
+unsigned char dcfConfidence;			// No. of consecutive good frames that agree (0 = none)
+unsigned char dcfSynced;				// 1 once DCF has set the clock
+static unsigned long dcfLast;			// Last good frame (seconds since the epoch) ...
+static unsigned char dcfLastZone;		// ... its Z1 bit ...
+static unsigned long dcfLastClock;		// ... and the clock at the time
+
+#if DcfDemod == DcfDemod_Edge
+static void dcfEdge(dcftime_t tim, unsigned char pinstate);
+static int dcfOffset(dcftime_t tim);
+static char dcfLate(dcftime_t tim);
+#else
+static void dcfSample(unsigned char level);
+static void dcfSecond(void);
+static void dcfTrackPhase(void);
+#endif
+static void dcfPulseSeen(unsigned char pulse);
+static void dcfStartFrame(void);
+static void dcfEndOfFrame(char late);
 
 void DcfDecoderInit(task_t *dcfTask)
 {
 	dcfTask->timer = DcfPonInterval;	// Gives the required startup signal for the DCF module
 
-#if 0	// DCF disabled for the moment
-
-	pinMode(DcfInputPin, INPUT_PULLUP);
-	pinMode(DcfPonPin, OUTPUT);
+#if DcfDemod == DcfDemod_Edge
+	dcfQHead = 0;
+	dcfQTail = 0;
+
+	// Timer 2: normal mode, clock/1024, overflow interrupt
+	TCCR2A = 0;
+	TCCR2B = _BV(CS22) | _BV(CS21) | _BV(CS20);
+	TCNT2 = 0;
+	TIFR2 = _BV(TOV2);
+	TIMSK2 = _BV(TOIE2);
+
+	// INT0 on any change. The pin is fixed, so INT0_vect is used directly instead of going through
+	// attachInterrupt()'s dispatcher and its indirect call.
+	static_assert(DcfInputPin::number == 2, "the DCF input must be on INT0");
+	EICRA = (EICRA & ~(_BV(ISC01) | _BV(ISC00))) | _BV(ISC00);
+	EIFR = _BV(INTF0);
+	EIMSK |= _BV(INT0);
+#else
+	for ( unsigned char i = 0; i < DcfBins; i++ )
+		dcfAcc[i] = 0;
+	dcfBin = 0;
+	dcfPhase = 0;
+	dcfCountA = 0;
+	dcfCountB = 0;
+#endif
 
-	attachInterrupt(digitalPinToInterrupt(DcfInputPin), DcfInterruptHandler, CHANGE);
+	DcfInputPin::input_pullup();
+	DcfPonPin::output();
 
-	digitalWrite(DcfPonPin, HIGH);		// Drive the pin high (DCF off)
+	DcfPonPin::high();		// Drive the pin high (DCF off)
 	dcfState = DcfState_Pon;
-	dcfPulse = 2;
-#endif
 }
 
 void DcfDecoder(task_t *dcfTask, unsigned long elapsed)
 {
+#if DcfDemod == DcfDemod_Edge
 	dcfTask->timer += DcfInterval;
 
-#if 0	// DCF disabled for the moment
-	switch (dcfState)
+	if ( dcfState == DcfState_Pon )
+		DcfPonPin::low();		// Drive the pin low (DCF on)
+
+	// Decode all the edges that have arrived since the last time.
+	unsigned char tail = dcfQTail;
+	while ( tail != dcfQHead )
 	{
-	case DcfState_Pon:
-		digitalWrite(DcfPonPin, LOW);
-		break;
+		dcfEdge(dcfQueue[tail].time, dcfQueue[tail].level);
+		tail = (tail + 1) & DcfQueueMask;
+		dcfQTail = tail;
+	}
+#else
+	dcfTask->timer += DcfSampleInterval;
 
-	case DcfState_Sync:
-		break;
+	if ( dcfState == DcfState_Pon )
+	{
+		DcfPonPin::low();		// Drive the pin low (DCF on)
+		dcfState = DcfState_Sync;
+		return;
+	}
+
+	dcfSample(DcfInputPin::read());
+#endif
+}
+
+#if DcfDemod == DcfDemod_Edge
+// Timer 2 overflow: extend the edge time base to 32 bits
+ISR(TIMER2_OVF_vect)
+{
+	dcfTimeHigh++;
+}
+
+// DcfReadTime() - read the edge time base. Must be called with interrupts disabled.
+static inline dcftime_t DcfReadTime(void)
+{
+	unsigned char lo = TCNT2;
+	unsigned long hi = dcfTimeHigh;
 
-	case DcfState_0:
-		break;
+	if ( (TIFR2 & _BV(TOV2)) != 0 && lo < 0x80 )
+		hi++;							// Timer has overflowed but the interrupt hasn't run yet
 
-	case DcfState_1:
-		break;
+	return (hi << 8) | lo;
+}
+
+// INT0: record the time and direction of an edge on the DCF input
+ISR(INT0_vect)
+{
+	dcftime_t tim = DcfReadTime();		// As close as possible to the edge time
+	unsigned char pinstate = DcfInputPin::read();
+	unsigned char head = dcfQHead;
+	unsigned char next = (head + 1) & DcfQueueMask;
 
-	default:
-		break;
+	if ( next == dcfQTail )
+	{
+		dcfQOverflow++;					// Full. Drop the edge; the decoder will resync.
+		return;
 	}
-#endif
+
+	dcfQueue[head].time = tim;
+	dcfQueue[head].level = pinstate;
+	dcfQHead = next;					// Publish the edge only when it's complete
+}
+
+// DcfSecondTick() - record the time of the timekeeper's second tick
+void DcfSecondTick(void)
+{
+	unsigned char sreg = SREG;
+	cli();
+	dcfTickTime = DcfReadTime();
+	SREG = sreg;
 }
 
-static void DcfInterruptHandler(void)
+// dcfOffset() - return the time in ms from the last second tick to a DCF second mark, -500..+500
+static int dcfOffset(dcftime_t tim)
 {
-	unsigned tim = ReadTime();			// As close as possible to the edge time
-	unsigned char pinstate = digitalRead(DcfInputPin);
+	// Signed, because the tick might have happened after the edge but before it was taken from the queue.
+	long ms = (long)(tim - dcfTickTime) * 64 / 1000;
+
+	ms %= 1000;
+	if ( ms > 500 )
+		ms -= 1000;
+	else if ( ms < -500 )
+		ms += 1000;
+	return (int)ms;
+}
+
+// dcfLate() - return 1 if the clock hasn't yet ticked the second that started at a DCF second mark
+static char dcfLate(dcftime_t tim)
+{
+	long ms = (long)(tim - dcfTickTime) * 64 / 1000;
+	return ( ms > 500 );
+}
 
+// dcfEdge() - decode an edge taken from the queue
+static void dcfEdge(dcftime_t tim, unsigned char pinstate)
+{
 #if 0	// ToDo: decide which LED to flash for tell-tale
 	setled(seg_ldp1, pinstate==HIGH?1:0);
 	display_change |= change_leds;
@@ -117,7 +304,7 @@ static void DcfInterruptHandler(void)
 		return;
 	}
 
-	unsigned width = tim - leadingTime;
+	dcftime_t width = tim - leadingTime;
 
 	if ( width < DcfDebounce )
 		return;							// Ignore any changes that come too close together
@@ -132,7 +319,7 @@ static void DcfInterruptHandler(void)
 			{
 				// Start receiving bits
 				dcfState = DcfState_1;
-				bitNo = 0;
+				dcfStartFrame();
 			}
 			return;
 		}
@@ -144,234 +331,384 @@ static void DcfInterruptHandler(void)
 		// Had a pulse
 		if ( width >= DcfMin0 && width <= DcfMax0 )
 		{
-			// A good 0 pulse - signal the background task
-			dcfPulse = 0;
+			// A good 0 pulse
+			dcfState = DcfState_0;
+			dcfPulseSeen(0);
 			return;
 		}
 		if ( width >= DcfMin1 && width <= DcfMax1 )
 		{
 			// A good 1 pulse
-			dcfPulse = 1;
+			dcfState = DcfState_0;
+			dcfPulseSeen(1);
 			return;
 		}
 		// Out-of-spec pulse - try to resync.
-		dcfPulse = 2;
+		dcfPulseSeen(2);
 		dcfState = DcfState_Sync;
 		return;
 	}
 	if ( dcfState == DcfState_0 && pinstate == HIGH )
 	{
 		leadingTime = tim;
+		dcfState = DcfState_1;
+
+		if ( width >= DcfMinSync && width <= DcfMaxSync )
+		{
+			// Second 59 has no pulse, so this is second 0 of the next minute.
+			if ( dcfSynced )
+				second_mark(dcfOffset(tim));
+			dcfEndOfFrame(dcfLate(tim));
+			dcfStartFrame();
+		}
+		else if ( width < DcfMinSec || width > DcfMaxSec )
+		{
+			// Missing or extra pulse - try to resync.
+			dcfState = DcfState_Sync;
+		}
+		else if ( dcfSynced )
+		{
+			second_mark(dcfOffset(tim));
+		}
 	}
 }
 
-#if 0
-unsigned char calcParity(unsigned char x)
+#endif
+
+#if DcfDemod == DcfDemod_Correlate
+// DcfSecondTick() - record the position in the second of the timekeeper's second tick
+void DcfSecondTick(void)
 {
-	unsigned char p = x;
-	p = (p ^ (p >> 4));
-	p = (p ^ (p >> 2));
-	p = (p ^ (p >> 1)) & 0x01;
-	return p;
+	dcfTickBin = dcfBin;
 }
 
-
-// DCF Sample task
-#define dcfSampleInterval	5		//	5 milliseconds
-#define dcfDebounce			50		//	50 milliseconds
-#define dcfPulseWidthZero	100		//	100 milliseconds pulse width --> binary 0
-#define dcfPulseWidthOne	200		//	200 milliseconds pulse width --> binary 1
-#define dcfPulseWidthThrsh	((dcfPulseWidthZero+dcfPulseWidthOne)/2)
-#define dcfPulseInterval	1000	//	Period of DCF pulses
-#define dcfState0			LOW
-#define dcfState1			HIGH
-unsigned char dcfState = 3;
-unsigned dcfWidth = 0;
-unsigned dcfGapThrsh = (dcfPulseInterval+dcfDebounce-dcfPulseWidthZero);
-unsigned char dcfShiftReg[8] = {0,0,0,0,0,0,0,0};
-unsigned char dcfBitCount = 0;
-
-// Extracted time and date.
-unsigned char dcfSecond;
-unsigned char dcfMinute;
-unsigned char dcfHour;
-unsigned char dcfDay;
-unsigned char dcfMonth;
-unsigned char dcfYear;
-unsigned char dcfDow;
-
-void dcfPush(unsigned char bitval);
-void dcfCalculateTime(void);
-void dcfWriteTime(void);
-
-void DcfSampleInit(task_t *dcfTask)
+// dcfSample() - process one sample of the DCF input
+static void dcfSample(unsigned char level)
 {
-	dcfTask->timer = dcfPowerOnInterval;
+	// Leaky average of the input level at this position in the second (full scale 248)
+	dcfAcc[dcfBin] = dcfAcc[dcfBin] - (dcfAcc[dcfBin] >> 3) + ( level ? 31 : 0 );
+
+	unsigned char r = ( dcfBin >= dcfPhase ) ? (dcfBin - dcfPhase) : (dcfBin + DcfBins - dcfPhase);
+
+	if ( r == 0 )
+		dcfSecond();
+
+	if ( r < DcfBinsA )
+		dcfCountA += level;
+	else if ( r < DcfBinsA + DcfBinsB )
+		dcfCountB += level;
+
+	dcfBin++;
+	if ( dcfBin >= DcfBins )
+	{
+		dcfBin = 0;
+		dcfTrackPhase();
+	}
 }
 
-void DcfSample(task_t *dcfTask, unsigned long elapsed)
+// dcfSecond() - called at the start of each second. Decide what the previous second contained.
+static void dcfSecond(void)
 {
-	dcfWidth += dcfSampleInterval;
-	if ( dcfState == 0 )
+	unsigned char bit = ( dcfCountB * 2 > DcfBinsB );
+	unsigned char conf = ( dcfCountB * 2 > DcfBinsB ) ? (dcfCountB * 2 - DcfBinsB) : (DcfBinsB - dcfCountB * 2);
+
+	if ( dcfCountA * 2 < DcfBinsA )
 	{
-		// Sample the state of the DCF input.
-		if ( digitalRead(DcfInputPin) == dcfState1 && dcfWidth > dcfDebounce )
+		// No pulse. At the end of the frame, that's second 59 and a new minute starts now.
+		// Earlier in the frame it's a lost pulse: keep the data bit but mark it as unreliable.
+		if ( dcfState == DcfState_Sync || bitNo >= DcfFrameBits )
 		{
-			// Change of state. Start measuring the width of the pulse.
-			dcfState = 1;
-			dcfWidth = 0;
-			dcfSecond++;
-			if ( (dcfSecond & 0xf) > 9 )
+			if ( dcfState != DcfState_Sync )
 			{
-				// BCD adjust
-				dcfSecond += 6;
+				// If the second tick was more than half a second ago, the clock is a second behind the mark
+				unsigned char r = ( dcfBin >= dcfTickBin ) ? (dcfBin - dcfTickBin) : (dcfBin + DcfBins - dcfTickBin);
+				dcfEndOfFrame(r > DcfBins/2);
 			}
-			SetDigitBit(4, 3, 1);
-			SetDigitBit(4, 4, 1);
-// Temp
-			SetDigitBit(0, 7, 1);
-			SetDigitBit(1, 7, 0);
-			SetDigitBit(2, 7, 1);
-			SetDigitBit(3, 7, 0);
-		}
-		else if ( dcfWidth > dcfGapThrsh )
-		{
-			// No leading edge seen --> it's a gap.
-			// Leading edge of next pulse is start of a new minute.
-			dcfState = 2;
-			dcfWidth = 0;
-			dcfCalculateTime();
+			dcfState = DcfState_Rx;
+			dcfStartFrame();
+			dcfCountA = 0;
+			dcfCountB = 0;
+			return;
 		}
+		conf = 0;
 	}
-	else if ( dcfState == 1 )
+
+	if ( dcfState == DcfState_Rx )
 	{
-		// Sample the state of the DCF input.
-		if ( digitalRead(DcfInputPin) == dcfState0 && dcfWidth > dcfDebounce )
+		if ( dcfSynced && conf > 0 )
 		{
-			// Change of state. Push the bit value into the shift register.
-			dcfPush((dcfWidth > dcfPulseWidthThrsh) ? 1 : 0);
-			dcfState = 0;
-			dcfWidth = 0;
-			SetDigitBit(4, 3, 0);
-			SetDigitBit(4, 4, 0);
-// Temp
-			SetDigitBit(0, 7, 0);
-			SetDigitBit(1, 7, 1);
-			SetDigitBit(2, 7, 0);
-			SetDigitBit(3, 7, 1);
+			// Offset of the second boundary from the second tick, at the resolution of the samples
+			int bins = (int)dcfPhase - (int)dcfTickBin;
+			if ( bins > DcfBins/2 )
+				bins -= DcfBins;
+			else if ( bins < -DcfBins/2 )
+				bins += DcfBins;
+			second_mark(bins * (1000/DcfBins));
 		}
+
+		if ( conf < dcfWeakConf )
+		{
+			dcfWeakConf = conf;
+			dcfWeakBit = bitNo;
+		}
+		dcfPulseSeen(bit);
+
+		if ( bitNo > DcfFrameBits + 1 )
+			dcfState = DcfState_Sync;		// Longer than a leap-second frame; look for the minute again
+	}
+
+	dcfCountA = 0;
+	dcfCountB = 0;
+}
+
+// dcfTrackPhase() - find the start of the second by correlating the averages with a rising edge
+// Called once per second.
+static void dcfTrackPhase(void)
+{
+	int before = 0;
+	int after = 0;
+
+	for ( unsigned char i = 0; i < DcfBinsA; i++ )
+	{
+		before += dcfAcc[DcfBins - DcfBinsA + i];
+		after += dcfAcc[i];
 	}
-	else if ( dcfState == 2 )
+
+	int bestScore = after - before;
+	int curScore = bestScore;
+	unsigned char best = 0;
+
+	for ( unsigned char p = 1; p < DcfBins; p++ )
 	{
-		// Waiting for start of minute.
-		if ( digitalRead(DcfInputPin) == dcfState1 )
+		// Slide both windows on by one bin
+		unsigned char out = p - 1;
+		unsigned char in = p + DcfBinsA - 1;
+		if ( in >= DcfBins )
+			in -= DcfBins;
+		before += dcfAcc[out] - dcfAcc[( out >= DcfBinsA ) ? (out - DcfBinsA) : (out + DcfBins - DcfBinsA)];
+		after += dcfAcc[in] - dcfAcc[out];
+
+		int score = after - before;
+		if ( score > bestScore )
 		{
-			// Change of state. Start measuring the width of the pulse.
-			unsigned char i;
-
-			dcfState = 1;
-			dcfWidth = 0;
-			if ( dcfDow != 0 )
-			{
-				dcfWriteTime();
-			}
-			dcfBitCount = 0;
-			dcfSecond = 0;
-			for ( i = 0; i < 8; i++ )
-			{
-				dcfShiftReg[i] = 0;
-			}
-			SetDigitBit(4, 3, 1);
-			SetDigitBit(4, 4, 1);
+			bestScore = score;
+			best = p;
 		}
+		if ( p == dcfPhase )
+			curScore = score;
 	}
-	else
+
+	// Change phase only if the new one is clearly better; that restarts the frame.
+	if ( best != dcfPhase && bestScore > DcfMinContrast && bestScore > curScore + (curScore >> 3) )
 	{
-		// End of delay to allow DCF to stabilise; turn it on.
-		dcfState = 0;
-		dcfWidth = 0;
-		digitalWrite(DcfPonPin, LOW);		// Drive the pin low (DCF on)
+		dcfPhase = best;
+		dcfState = DcfState_Sync;
+		dcfCountA = 0;
+		dcfCountB = 0;
 	}
-	dcfTask->timer += dcfSampleInterval;
 }
+#endif
 
-void dcfPush(unsigned char bitval)
+// dcfPulseSeen() - handle a decoded pulse: 0, 1 or 2 (out of spec)
+static void dcfPulseSeen(unsigned char pulse)
 {
-	Serial.print(bitval?"1":"0");
-	if ( bitval != 0 )
+	if ( pulse > 1 )
+		return;							// Out of spec; the frame is abandoned at the resync
+
+	if ( bitNo < DcfFrameBits )
 	{
-		dcfShiftReg[dcfBitCount/8] |= ( 1 << (dcfBitCount%8) );
+		if ( pulse )
+			dcfShiftReg[bitNo >> 3] |= (1 << (bitNo & 0x07));
 	}
-	dcfBitCount++;
+	if ( bitNo < 0xff )
+		bitNo++;
+}
+
+// DcfInject() - feed a synthetic pulse to the frame decoder: '0', '1' or 'm' (minute mark)
+// Used by the console for testing. The demodulator is bypassed, so the phase and the
+// second-mark offset aren't affected.
+void DcfInject(char c)
+{
+	if ( c == 'm' )
+	{
+		dcfEndOfFrame(0);
+		dcfStartFrame();
+	}
+	else
+		dcfPulseSeen(c == '1');
+}
+
+// dcfStartFrame() - clear the shift register ready for a new minute
+static void dcfStartFrame(void)
+{
+	for ( unsigned char i = 0; i < 8; i++ )
+		dcfShiftReg[i] = 0;
+	bitNo = 0;
+#if DcfDemod == DcfDemod_Correlate
+	dcfWeakConf = 0xff;
+#endif
+}
+
+// dcfBit() - return a single bit from the shift register
+static unsigned char dcfBit(unsigned char n)
+{
+	return (dcfShiftReg[n >> 3] >> (n & 0x07)) & 0x01;
+}
+
+// dcfField() - return a field of up to 8 bits from the shift register, LSB first
+static unsigned char dcfField(unsigned char first, unsigned char n)
+{
+	unsigned char v = 0;
+	for ( unsigned char i = 0; i < n; i++ )
+		v |= dcfBit(first + i) << i;
+	return v;
+}
+
+// dcfParity() - return the exclusive-or of bits first..last inclusive (0 means even parity)
+static unsigned char dcfParity(unsigned char first, unsigned char last)
+{
+	unsigned char p = 0;
+	for ( unsigned char i = first; i <= last; i++ )
+		p ^= dcfBit(i);
+	return p;
+}
+
+// dcfBcd() - convert a BCD field to binary. Returns 0xff if either digit is out of range
+static unsigned char dcfBcd(unsigned char v)
+{
+	if ( (v & 0x0f) > 9 || (v >> 4) > 9 )
+		return 0xff;
+	return (v >> 4) * 10 + (v & 0x0f);
 }
 
-const char hexDigit[16] = { '0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f' };
-const char *strDay[8] = { "??", "Mo", "Tu", "We", "Th", "Fr", "Sa", "Su" };
+// dcfDecodeFrame() - check a complete frame and convert it to a date/time
+// Returns 0 if the frame is good, otherwise one of the DcfErr_xxx codes.
+unsigned char dcfDecodeFrame(datetime_t *dt)
+{
+	if ( bitNo != DcfFrameBits )
+		return ( bitNo < DcfFrameBits ) ? DcfErr_Short : DcfErr_Long;
+
+	if ( dcfBit(DcfBit_M) != 0 || dcfBit(DcfBit_S) != 1 )
+		return DcfErr_Fixed;
+
+	if ( dcfParity(DcfBit_Min, DcfBit_P1) != 0 ||
+		 dcfParity(DcfBit_Hour, DcfBit_P2) != 0 ||
+		 dcfParity(DcfBit_Day, DcfBit_P3) != 0 )
+		return DcfErr_Parity;
+
+	// Exactly one of CEST (Z1) and CET (Z2) is in effect.
+	if ( dcfBit(DcfBit_Z1) == dcfBit(DcfBit_Z2) )
+		return DcfErr_Zone;
+
+	unsigned char mi = dcfBcd(dcfField(DcfBit_Min, 7));
+	unsigned char ho = dcfBcd(dcfField(DcfBit_Hour, 6));
+	unsigned char da = dcfBcd(dcfField(DcfBit_Day, 6));
+	unsigned char dw = dcfField(DcfBit_Dow, 3);
+	unsigned char mo = dcfBcd(dcfField(DcfBit_Month, 5));
+	unsigned char yr = dcfBcd(dcfField(DcfBit_Year, 8));
+
+	if ( mi > 59 || ho > 23 || dw < 1 || dw > 7 || mo < 1 || mo > 12 || yr > 99 )
+		return DcfErr_Range;
+
+	unsigned years = 2000 + yr;
+
+	if ( da < 1 || da > monthlength(mo - 1, years) )
+		return DcfErr_Range;
+
+	dt->years = years;
+	dt->days = date_to_yday(years, mo, da);
 
-void dcfCalculateTime(void)
+	// The day of the week is redundant, so it's a free plausibility check
+	if ( dw != day_of_week(days_since_epoch(years) + dt->days) )
+		return DcfErr_Range;
+	dt->hours = ho;
+	dt->mins = mi;
+
+	return DcfErr_None;
+}
+
+// dcfConsensus() - decide whether a good frame can be trusted enough to set the clock
+// Returns 0 if not, 1 if the clock should be set, 2 if the clock already shows the right time.
+// A frame is trusted if it's within a few seconds of a clock that has already been synchronised,
+// or if it follows on from the previous good frames.
+// If late is 1, the clock is about to tick the second that started at the minute mark.
+static unsigned char dcfConsensus(const datetime_t *dt, char late)
 {
-	unsigned char pErr;
+	unsigned char zone = dcfBit(DcfBit_Z1);
+	unsigned long frame = maketime(dt);
+	unsigned long clk = getepoch();
 
-	if ( dcfBitCount == 59 )
+	if ( dcfConfidence > 0 && zone == dcfLastZone )
 	{
-		if ( (dcfShiftReg[0] & 0x01 != 0) ||
-			 (dcfShiftReg[2] & 0x10 == 0 ) )
+		// No. of minutes since the last good frame, measured by the clock
+		long gap = ((long)(clk - dcfLastClock) + 30) / 60;
+
+		if ( frame == dcfLast + gap * 60 )
 		{
-			// Error in fixed bits
-			Serial.println("F");
+			if ( dcfConfidence < DcfAgreeFull )
+				dcfConfidence++;
 		}
 		else
-		{
-			dcfMinute	= ((dcfShiftReg[2] >> 5) & 0x07) | ((dcfShiftReg[3] << 3) & 0x78);
-			dcfHour		= ((dcfShiftReg[3] >> 5) & 0x07) | ((dcfShiftReg[4] << 3) & 0x38);
-			dcfDay		= ((dcfShiftReg[4] >> 4) & 0x0f) | ((dcfShiftReg[5] << 4) & 0x30);
-			dcfMonth	= ((dcfShiftReg[5] >> 5) & 0x07) | ((dcfShiftReg[6] << 3) & 0x18);
-			dcfYear		= ((dcfShiftReg[6] >> 2) & 0x3f) | ((dcfShiftReg[7] << 6) & 0xc0);
-			dcfDow		= ((dcfShiftReg[5] >> 2) & 0x07);
-			pErr = calcParity(dcfMinute) ^ ((dcfShiftReg[3] & 0x10) != 0);
-			pErr |= (calcParity(dcfHour) ^ ((dcfShiftReg[4] & 0x08) != 0)) << 1;
-			pErr |= (calcParity(dcfDay^dcfMonth^dcfYear^dcfDow) ^ ((dcfShiftReg[7] & 0x04) != 0)) << 2;
-
-			if ( pErr )
-			{
-				if ( pErr & 1 )	Serial.print('M');
-				if ( pErr & 2 )	Serial.print('H');
-				if ( pErr & 4 )	Serial.print('D');
-				Serial.println('P');
-			}
-			else
-			{
-				Serial.println('0');
-			}
+			dcfConfidence = 1;
+	}
+	else
+		dcfConfidence = 1;
 
-			Serial.print(strDay[dcfDow]);
-			Serial.print(' ');
-			Serial.print("20");
-			Serial.print(hexDigit[dcfYear>>4]);
-			Serial.print(hexDigit[dcfYear&0xf]);
-			Serial.print('-');
-			Serial.print(hexDigit[dcfMonth>>4]);
-			Serial.print(hexDigit[dcfMonth&0xf]);
-			Serial.print('-');
-			Serial.print(hexDigit[dcfDay>>4]);
-			Serial.print(hexDigit[dcfDay&0xf]);
-			Serial.print(' ');
-			Serial.print(hexDigit[dcfHour>>4]);
-			Serial.print(hexDigit[dcfHour&0xf]);
-			Serial.print(':');
-			Serial.print(hexDigit[dcfMinute>>4]);
-			Serial.println(hexDigit[dcfMinute&0xf]);
+	dcfLast = frame;
+	dcfLastZone = zone;
+	dcfLastClock = clk;
 
-		}
-	}
-	else if ( dcfBitCount < 59 )
+	long diff = (long)(clk - frame) + late;
+	if ( dcfSynced && diff == 0 )
+		return 2;						// Already right; the phase lock takes care of the rest
+	if ( dcfSynced && diff >= -DcfMaxStep && diff <= DcfMaxStep )
+		return 1;						// No jump, just realign the seconds
+
+	if ( dcfConfidence >= DcfAgreeFull )
+		return 1;						// Enough agreement to jump a synchronised clock
+
+	if ( !dcfSynced && dcfConfidence >= DcfAgreeFast )
+		return 1;						// Fast accept: nothing to lose
+
+	return 0;
+}
+
+// dcfEndOfFrame() - called at the leading edge of second 0. Decode the frame and set the time.
+// late is 1 if the clock hasn't yet ticked the second that started at the leading edge.
+static void dcfEndOfFrame(char late)
+{
+	datetime_t dt;
+	unsigned char err = dcfDecodeFrame(&dt);
+
+#if DcfDemod == DcfDemod_Correlate
+	if ( err == DcfErr_Parity && dcfWeakConf <= 1 )
 	{
-		Serial.println("-");
+		// Soft decision: a parity error is most likely in the least reliable bit, so try flipping it.
+		dcfShiftReg[dcfWeakBit >> 3] ^= (1 << (dcfWeakBit & 0x07));
+		err = dcfDecodeFrame(&dt);
 	}
-	else
+#endif
+
+	unsigned char c = ( err == DcfErr_None ) ? dcfConsensus(&dt, late) : 0;
+
+	if ( c == 2 )
+		drift_reference();
+	else if ( c == 1 )
 	{
-		Serial.println("+");
+		settime(&dt);
+		dcfSynced = 1;
+		dcfLastClock = getepoch();		// The clock has moved
+		update_time = 1;				// Show the new time now, not at the next change of minute
+		display_notify();
 	}
-}
 
+#if LOG_DCF >= LOG_INFO
+#if DcfDemod == DcfDemod_Edge
+	unsigned char lost = dcfQOverflow;
+#else
+	unsigned char lost = 0;
 #endif
+	unsigned char rec[3] = { err, dcfConfidence, lost };
+	tlm_record(TLM_DCF_FRAME, rec, 3);
+#endif
+}
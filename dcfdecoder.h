@@ -24,6 +24,27 @@
 #ifndef DCFDECODER_H
 #define DCFDECODER_H	1
 
+#include "tasker.h"
+#include "timekeeper.h"
+
+// Results of dcfDecodeFrame()
+#define DcfErr_None		0		// Good frame
+#define DcfErr_Short	1		// Fewer than 59 bits
+#define DcfErr_Long		2		// More than 59 bits
+#define DcfErr_Fixed	3		// M or S bit wrong
+#define DcfErr_Parity	4		// P1, P2 or P3 wrong
+#define DcfErr_Zone		5		// Z1 and Z2 both set or both clear
+#define DcfErr_Range	6		// A field is out of range
+
+extern unsigned char dcfShiftReg[8];
+extern unsigned char bitNo;
+extern unsigned char dcfConfidence;
+extern unsigned char dcfSynced;
+
+unsigned char dcfDecodeFrame(datetime_t *dt);
+void DcfSecondTick(void);
+void DcfInject(char c);
+
 void DcfDecoderInit(task_t *dcfTask);
 void DcfDecoder(task_t *dcfTask, unsigned long elapsed);
 
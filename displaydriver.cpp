@@ -22,6 +22,7 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include "dcfclock.h"
+#include "fastpin.h"
 #include "tasker.h"
 #include "displaydriver.h"
 #include "timekeeper.h"
@@ -32,16 +33,18 @@
 #define SpiMosi			11			// SPI output data (MOSI)
 #define SpiMiso			12			// SPI input data (not used)
 
-#define SrLatch4		10			// Latch the four main digits
-#define SrLatch1		9			// Latch the extra LEDs (left DP, colon etc.)
+typedef FastPin<10> SrLatch4;		// Latch the four main digits
+typedef FastPin<9> SrLatch1;		// Latch the extra LEDs (left DP, colon etc.)
 
-#define ddInterval		Ticks(100)	// 100 ms
+// The timekeeper wakes the driver on every second tick and the button handler after every change,
+// so the interval is only a fallback.
+#define ddInterval		Ticks(1000)	// 1 s
 
 unsigned char display[nDigits];
 unsigned char display_change;
 unsigned char display_mode;
 
-const unsigned char digit_to_7seg[16] =
+const unsigned char digit_to_7seg[16] PROGMEM =
 {
 	chargen_0, chargen_1, chargen_2, chargen_3,
 	chargen_4, chargen_5, chargen_6, chargen_7,
@@ -49,23 +52,36 @@ const unsigned char digit_to_7seg[16] =
 	chargen_c, chargen_d, chargen_e, chargen_f,
 };
 
-const unsigned char left_dp[4] =
+// display[] is the back buffer that the set_xxx() functions compose into. Setting display_change
+// commits it: the driver then copies it to the front buffer, which is what the SPI interrupt sends.
+static unsigned char ddFront[nDigits];	// Last frame committed (and sent, once ddBusy is 0)
+static volatile unsigned char ddIndex;	// Next byte to send
+static unsigned char ddLatch;			// Latches to pulse at the end (change_xxx bits)
+static volatile unsigned char ddBusy;	// A frame is being sent
+
+static unsigned char ddFlip(void);
+
+const unsigned char left_dp[4] PROGMEM =
 {
 	seg_ldp1, seg_ldp2, seg_ldp3, seg_ldp4
 };
 
+static task_t *ddtask;
+
 void DisplayDriverInit(task_t *displayDriveTask)
 {
-	pinMode(SrLatch1, OUTPUT);		// Drive LOW to HIGH to latch the "extra LEDs"
-	pinMode(SrLatch4, OUTPUT);		// Drive LOW to HIGH to latch the four digits
+	ddtask = displayDriveTask;		// Remember this for use in display_notify()
+
+	SrLatch1::output();				// Drive LOW to HIGH to latch the "extra LEDs"
+	SrLatch4::output();				// Drive LOW to HIGH to latch the four digits
 	pinMode(SpiClk, OUTPUT);		// SPI clock
 	pinMode(SpiMosi, OUTPUT);		// SPI output data
 	pinMode(SpiMiso, INPUT_PULLUP);	// SPI input data (not used)
 
 	digitalWrite(SpiClk, LOW);		// Set clock and data to known states
 	digitalWrite(SpiMosi, LOW);
-	digitalWrite(SrLatch1, LOW);	// Set both latch pins to inactive
-	digitalWrite(SrLatch4, LOW);
+	SrLatch1::low();				// Set both latch pins to inactive
+	SrLatch4::low();
 
 	SPI.begin();
 	SPI.setBitOrder(MSBFIRST);
@@ -87,10 +103,10 @@ void DisplayDriverInit(task_t *displayDriveTask)
 	setdigitsegments(4, 0xff);
 	display_change |= change_digits;
 	
-	digitalWrite(SrLatch1, HIGH);	// Latch the cleared SRs into the outputs
-	digitalWrite(SrLatch1, LOW);
-	digitalWrite(SrLatch4, HIGH);
-	digitalWrite(SrLatch4, LOW);
+	SrLatch1::high();	// Latch the cleared SRs into the outputs
+	SrLatch1::low();
+	SrLatch4::high();
+	SrLatch4::low();
 
 	displayDriveTask->timer = ddInterval;
 }
@@ -148,26 +164,66 @@ void DisplayDriver(task_t *displayDriveTask, unsigned long elapsed)
 
 	update_time = 0;
 
-	switch ( display_change )
+	if ( display_change != 0 && ddFlip() )
+		display_change = 0;
+}
+
+// display_notify() - run the display driver as soon as possible
+void display_notify(void)
+{
+	taskerNotify(ddtask);
+}
+
+// ddFlip() - copy the back buffer to the front buffer and start sending the parts that have changed.
+// The SPI interrupt sends the remaining bytes and pulses the latches, so this returns at once.
+// Returns 0 if the previous frame is still being sent; the caller keeps the commit for next time.
+static unsigned char ddFlip(void)
+{
+	if ( ddBusy )
+		return 0;
+
+	unsigned char change = 0;
+	for ( unsigned char i = 0; i < nDigits; i++ )
 	{
-	case 0x00:	// Nothing
-		break;
-	case change_leds:		// Only update the extra LEDs
-		SPI.transfer(~display[4]);
-		digitalWrite(SrLatch1, HIGH);
-		digitalWrite(SrLatch1, LOW);
-		break;
-	default:				// Update digits or digits and extra LEDs
-		for ( int i = 0; i < nDigits; i++ )
-			SPI.transfer(~display[i]);
-		digitalWrite(SrLatch4, HIGH);
-		digitalWrite(SrLatch4, LOW);
-		if ( display_change == change_all )
+		if ( display[i] != ddFront[i] )
 		{
-			digitalWrite(SrLatch1, HIGH);
-			digitalWrite(SrLatch1, LOW);
+			change |= ( i < 4 ) ? change_digits : change_leds;
+			ddFront[i] = display[i];
 		}
-		break;
 	}
-	display_change = 0;
+
+	if ( change == 0 )
+		return 1;					// Same as the frame on the display: nothing to send
+
+	// Only the extra LEDs changed: one byte is enough because the digit latches aren't pulsed.
+	ddIndex = ( change == change_leds ) ? 4 : 0;
+	ddLatch = change;
+	ddBusy = 1;
+	SPCR |= _BV(SPIE);
+	SPDR = ~ddFront[ddIndex++];
+	return 1;
+}
+
+// SPI transfer complete: send the next byte of the frame, or latch the frame when it's all sent
+ISR(SPI_STC_vect)
+{
+	if ( ddIndex < nDigits )
+	{
+		SPDR = ~ddFront[ddIndex++];
+		return;
+	}
+
+	if ( ddLatch & change_digits )
+	{
+		SrLatch4::high();
+		SrLatch4::low();
+	}
+	if ( ddLatch & change_leds )
+	{
+		SrLatch1::high();
+		SrLatch1::low();
+	}
+
+	SPCR &= ~_BV(SPIE);
+	ddBusy = 0;
 }
@@ -24,6 +24,7 @@
 #ifndef DISPLAYDRIVER_H
 #define DISPLAYDRIVER_H		1
 
+#include <avr/pgmspace.h>
 #include "tasker.h"
 
 // 5 digits: 4 real digits plus a set of assorted LEDs
@@ -72,9 +73,6 @@
 #define change_digits	0x02
 #define change_all		(change_leds|change_digits)
 
-// Check for update requests every 100 ms
-#define ddInterval	100
-
 // Display modes (lower 4 bits of display_mode)
 #define mode_hhmm	0x00		// Time mode
 #define mode_mmss	0x01		// Time mode
@@ -91,13 +89,16 @@ extern unsigned char display[nDigits];
 extern unsigned char display_change;
 extern unsigned char display_mode;
 extern unsigned char update_time;
-extern const unsigned char digit_to_7seg[16];
-extern const unsigned char left_dp[4];
+extern const unsigned char digit_to_7seg[16];	// In flash
+extern const unsigned char left_dp[4];			// In flash
 
 // The two tasker functions
 void DisplayDriverInit(task_t *);
 void DisplayDriver(task_t *, unsigned long elapsed);
 
+// Run the display driver at once (after a second tick or a button press)
+extern void display_notify(void);
+
 // setdigit() - sets all the segments (incl. dp) to specified values. Works for the extra leds too
 static inline void setdigit(int dig, unsigned char segs)
 {
@@ -123,15 +124,15 @@ static inline void setdigitdp(int dig, unsigned char dp)
 static inline void setleftdp(int dig, unsigned char dp)
 {
 	if ( dp )
-		display[4] |= left_dp[dig];
+		display[4] |= pgm_read_byte(&left_dp[dig]);
 	else
-		display[4] &= ~left_dp[dig];
+		display[4] &= ~pgm_read_byte(&left_dp[dig]);
 }
 
 // setdigitnumeric() - sets the segments a..g to a specified hexadecimal digit (leaves dp alone)
 static inline void setdigitnumeric(int dig, unsigned char num)
 {
-	setdigitsegments(dig, digit_to_7seg[num]);
+	setdigitsegments(dig, pgm_read_byte(&digit_to_7seg[num]));
 }
 
 // setcolon() - sets the colon LEDs on or off
@@ -0,0 +1,88 @@
+/* fastpin.h - direct port access for pins that are fixed at compile time
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+ *
+ *
+*/
+#ifndef FASTPIN_H
+#define FASTPIN_H	1
+
+#include <avr/io.h>
+
+#ifdef HOST_SIM
+/* Host build (see host/): the simulator keeps the pins, records every write and supplies the inputs.
+ * The interface is the same as the real one below. Modes are as for pinMode(): 0 INPUT, 1 OUTPUT, 2 INPUT_PULLUP.
+*/
+extern void sim_pin_mode(unsigned char pin, unsigned char mode);
+extern void sim_pin_write(unsigned char pin, unsigned char v);
+extern unsigned char sim_pin_read(unsigned char pin);
+extern void sim_pin_pcint(unsigned char pin);
+
+template <unsigned char n>
+class FastPin
+{
+public:
+	static const unsigned char number = n;
+
+	static inline void output(void)			{ sim_pin_mode(n, 1); }
+	static inline void input(void)			{ sim_pin_mode(n, 0); }
+	static inline void input_pullup(void)	{ sim_pin_mode(n, 2); }
+	static inline void high(void)			{ sim_pin_write(n, 1); }
+	static inline void low(void)			{ sim_pin_write(n, 0); }
+	static inline unsigned char read(void)	{ return sim_pin_read(n); }
+	static inline void pcint_enable(void)	{ sim_pin_pcint(n); }
+};
+
+#else
+
+/* FastPin<n> - Arduino pin n (Nano numbering: 0..7 PORTD, 8..13 PORTB, 14..19 PORTC)
+ *
+ * Everything is resolved at compile time, so high(), low() and read() become single sbi/cbi/sbic
+ * instructions instead of a call to digitalWrite()/digitalRead() with their table lookups.
+ * sbi and cbi don't disturb the other bits of the port, so they're safe to use in an ISR as well.
+*/
+template <unsigned char n>
+class FastPin
+{
+public:
+	static const unsigned char number = n;
+
+	static inline void output(void)			{ *ddr() |= mask(); }
+	static inline void input(void)			{ *ddr() &= ~mask(); *port() &= ~mask(); }
+	static inline void input_pullup(void)	{ *ddr() &= ~mask(); *port() |= mask(); }
+	static inline void high(void)			{ *port() |= mask(); }
+	static inline void low(void)			{ *port() &= ~mask(); }
+	static inline unsigned char read(void)	{ return (*pin() & mask()) != 0; }
+	static inline void pcint_enable(void)	{ *pcmsk() |= mask(); PCICR |= pcie(); }
+
+private:
+	static inline volatile uint8_t *port(void)	{ return (n < 8) ? &PORTD : (n < 14) ? &PORTB : &PORTC; }
+	static inline volatile uint8_t *ddr(void)	{ return (n < 8) ? &DDRD : (n < 14) ? &DDRB : &DDRC; }
+	static inline volatile uint8_t *pin(void)	{ return (n < 8) ? &PIND : (n < 14) ? &PINB : &PINC; }
+	static inline unsigned char mask(void)		{ return 1 << ((n < 8) ? n : (n < 14) ? (n - 8) : (n - 14)); }
+
+	// Pin-change interrupt group: PORTB is PCINT0..7, PORTC PCINT8..14, PORTD PCINT16..23
+	static inline volatile uint8_t *pcmsk(void)	{ return (n < 8) ? &PCMSK2 : (n < 14) ? &PCMSK0 : &PCMSK1; }
+	static inline unsigned char pcie(void)		{ return (n < 8) ? _BV(PCIE2) : (n < 14) ? _BV(PCIE0) : _BV(PCIE1); }
+};
+
+#endif
+
+#endif
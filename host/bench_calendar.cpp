@@ -0,0 +1,155 @@
+/* bench_calendar.cpp - time the calendar conversions against the day-by-day loops they replaced
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include <time.h>
+#include "calendar.h"
+
+// Prints one tab-separated line per function: calls and nanoseconds per call on the host, over
+// every day from 1900 to 2399. The "loop" rows are the month and year walks of the old code.
+// Host times only show the difference in complexity; they say nothing about AVR cycles.
+
+#define FIRST_YEAR	1900
+#define LAST_YEAR	2399
+#define DAYNO_1900	(-36524L)
+
+static volatile unsigned sink;			// Keeps the results alive
+
+static const unsigned char monthdays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+// The old set_DDMM()/decode_days(): walk the months
+static void loop_yday_to_date(unsigned y, unsigned yday, unsigned char *month, unsigned char *day)
+{
+	unsigned char m = 0;
+	for (;;)
+	{
+		unsigned char len = monthdays[m] + ( m == 1 && isleap(y) );
+		if ( yday < len )
+			break;
+		yday -= len;
+		m++;
+	}
+	*month = m + 1;
+	*day = yday + 1;
+}
+
+// The old breaktime(): walk the years from the epoch
+static void loop_days_to_year(long dayno, unsigned *years, unsigned *yday)
+{
+	unsigned y = CAL_EPOCH_YEAR;
+	while ( dayno < 0 )
+	{
+		y--;
+		dayno += 365 + isleap(y);
+	}
+	while ( dayno >= 365 + isleap(y) )
+	{
+		dayno -= 365 + isleap(y);
+		y++;
+	}
+	*years = y;
+	*yday = dayno;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *name, unsigned long n, double t0)
+{
+	printf("%s\t%lu\t%.1f\n", name, n, (now_ns() - t0) / n);
+}
+
+int main(void)
+{
+	long last = days_since_epoch(LAST_YEAR + 1);
+	unsigned long n;
+	double t0;
+	unsigned y, yday;
+	unsigned char m, d;
+
+	printf("function\tcalls\tns_per_call\n");
+
+	t0 = now_ns();
+	n = 0;
+	for ( long dn = DAYNO_1900; dn < last; dn++, n++ )
+	{
+		epoch_days_to_year(dn, &y, &yday);
+		sink += y + yday;
+	}
+	report("epoch_days_to_year", n, t0);
+
+	t0 = now_ns();
+	n = 0;
+	for ( long dn = DAYNO_1900; dn < last; dn++, n++ )
+	{
+		loop_days_to_year(dn, &y, &yday);
+		sink += y + yday;
+	}
+	report("loop_days_to_year", n, t0);
+
+	t0 = now_ns();
+	n = 0;
+	for ( y = FIRST_YEAR; y <= LAST_YEAR; y++ )
+	{
+		for ( yday = 0; yday < 365u + isleap(y); yday++, n++ )
+		{
+			yday_to_date(y, yday, &m, &d);
+			sink += m + d;
+		}
+	}
+	report("yday_to_date", n, t0);
+
+	t0 = now_ns();
+	n = 0;
+	for ( y = FIRST_YEAR; y <= LAST_YEAR; y++ )
+	{
+		for ( yday = 0; yday < 365u + isleap(y); yday++, n++ )
+		{
+			loop_yday_to_date(y, yday, &m, &d);
+			sink += m + d;
+		}
+	}
+	report("loop_yday_to_date", n, t0);
+
+	t0 = now_ns();
+	n = 0;
+	for ( y = FIRST_YEAR; y <= LAST_YEAR; y++ )
+	{
+		for ( m = 1; m <= 12; m++ )
+		{
+			for ( d = 1; d <= monthlength(m - 1, y); d++, n++ )
+				sink += date_to_yday(y, m, d);
+		}
+	}
+	report("date_to_yday", n, t0);
+
+	t0 = now_ns();
+	n = 0;
+	for ( long dn = DAYNO_1900; dn < last; dn++, n++ )
+		sink += day_of_week(dn);
+	report("day_of_week", n, t0);
+
+	return 0;
+}
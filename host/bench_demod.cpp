@@ -0,0 +1,146 @@
+/* bench_demod.cpp - DCF demodulator benchmark: time to the first good frame and bit error rate
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "dcfdecoder.h"
+#include "telemetry.h"
+#include "sim.h"
+#include "simdcf.h"
+
+// Usage: bench_demod_edge|bench_demod_corr snr_db [minutes]
+//        bench_demod_edge -h	(prints the header line)
+//
+// Prints one tab-separated line. The clock gets the DCF signal with noise at the given SNR for the
+// given number of minutes (default 60). Times are seconds from the start of the signal; -1 if it
+// never happened.
+//   first	first frame that decoded without error
+//   sync	first frame that set the clock
+//   frames	frames decoded (minute marks seen)
+//   good	frames without error
+//   bits	bits compared with the ones sent, and ...
+//   ber	... the fraction of them that were wrong
+//   lost	bits missing from frames (pulses not recognised)
+
+#ifndef BENCH_DEMOD
+#define BENCH_DEMOD	"edge"				// The demodulator that dcfdecoder.cpp was built with
+#endif
+
+#define T_START		SIM_S(3) + SIM_MS(370)	// Signal starts out of step with the clock's ticks
+#define MINUTE0		1710064800LL			// 2024-03-10 10:00:00
+
+static unsigned long frames, good, bits, errors, lost;
+static double t_first = -1, t_sync = -1;
+static double t_frame = -1;				// Latest minute mark seen by the decoder
+static unsigned tx_pos;
+
+// tlm_scan() - look through the new serial output for TLM_DCF_FRAME records
+static void tlm_scan(void)
+{
+	unsigned char rec[32];
+	unsigned start = tx_pos;
+
+	for ( unsigned i = tx_pos; i < sim_ntx; i++ )
+	{
+		if ( sim_tx[i] != 0 )
+			continue;
+
+		// COBS-decode sim_tx[start..i)
+		unsigned n = 0;
+		unsigned j = start;
+		while ( j < i && n < sizeof(rec) )
+		{
+			unsigned code = sim_tx[j++];
+			for ( unsigned k = 1; k < code && j < i && n < sizeof(rec); k++ )
+				rec[n++] = sim_tx[j++];
+			if ( code < 0xff && j < i && n < sizeof(rec) )
+				rec[n++] = 0;
+		}
+		start = i + 1;
+
+		if ( n >= 5 && rec[0] == TLM_DCF_FRAME )
+		{
+			// The record's time is the low 16 bits of ReadTime(): find the latest match before now
+			double now = (double)(sim_now - (T_START)) / 1e6;
+			double t16 = (rec[1] | (rec[2] << 8)) * 0.02;
+			double tnow = ((sim_now / 20000) & 0xffff) * 0.02;
+			double t = now - (tnow - t16 + ( t16 > tnow ? 65536 * 0.02 : 0 ));
+
+			frames++;
+			t_frame = t;
+			if ( rec[3] == DcfErr_None )
+			{
+				good++;
+				if ( t_first < 0 )
+					t_first = t;
+			}
+		}
+	}
+	tx_pos = start;
+}
+
+// bits_source() - at second 59.5, before the minute mark clears it, compare the shift register with the frame
+static simtime_t bits_source(simtime_t t)
+{
+	const char *sent = sim_dcf_sent();
+	unsigned n = ( bitNo < SIM_DCF_BITS ) ? bitNo : SIM_DCF_BITS;
+	double minute = (double)(t - (T_START)) / 1e6 - 59.5;
+
+	tlm_scan();
+
+	// Only frames that the decoder followed from the start of the minute
+	if ( t_frame >= minute - 0.5 && t_frame <= minute + 1.0 )
+	{
+		for ( unsigned i = 0; i < n; i++ )
+		{
+			unsigned char b = (dcfShiftReg[i >> 3] >> (i & 7)) & 1;
+			bits++;
+			if ( b != (unsigned char)(sent[i] - '0') )
+				errors++;
+		}
+		lost += SIM_DCF_BITS - n;
+	}
+
+	if ( dcfSynced && t_sync < 0 )
+		t_sync = minute;				// It happened at the last minute mark
+
+	return t + SIM_S(60);
+}
+
+int main(int argc, char **argv)
+{
+	if ( argc < 2 || argv[1][0] == '-' )
+	{
+		printf("demod\tsnr_db\tfirst\tsync\tframes\tgood\tbits\tber\tlost\tflips\n");
+		return 0;
+	}
+
+	double snr = atof(argv[1]);
+	int minutes = ( argc > 2 ) ? atoi(argv[2]) : 60;
+
+	sim_dcf_start(T_START, MINUTE0, snr, 12345);
+	sim_source(bits_source, T_START + SIM_S(59) + SIM_MS(500));
+	sim_run(T_START + SIM_S(60) * minutes);
+
+	printf("%s\t%.1f\t%.1f\t%.1f\t%lu\t%lu\t%lu\t%.5f\t%lu\t%lu\n", BENCH_DEMOD, snr, t_first, t_sync,
+			frames, good, bits, bits > 0 ? (double)errors / bits : 0.0, lost, sim_dcf_flips);
+	return 0;
+}
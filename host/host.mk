@@ -0,0 +1,82 @@
+# host.mk - build the clock on the host, with simulated hardware, and run the tests
+#
+# Part of dcfclock
+#
+# (c) David Haworth
+#
+# dcfclock is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# dcfclock is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+#
+# dcfclock is an Arduino sketch, written for an Arduino Nano
+
+# All the sketch's modules except timebase.cpp, which is replaced by host/simtimebase.cpp, and the
+# simulator (host/sim*.cpp).
+# Each test in host/test_*.cpp is linked with the whole clock and run by "make host".
+
+HOST_BUILD     = host/build
+HOST_CXX       = g++
+HOST_CXXFLAGS  = -O2 -g -Wall -Wno-unused-function -DHOST_SIM=1 -Ihost/include -I. -Ihost
+
+HOST_MODULES   = $(filter-out timebase.cpp, $(wildcard *.cpp)) $(wildcard host/sim*.cpp)
+HOST_TESTS     = $(patsubst host/%.cpp,$(HOST_BUILD)/%,$(wildcard host/test_*.cpp))
+HOST_OBJS      = $(patsubst %.cpp,$(HOST_BUILD)/%.o,$(notdir $(HOST_MODULES)))
+HOST_BENCHES   = $(patsubst host/%.cpp,$(HOST_BUILD)/%,$(filter-out host/bench_demod.cpp,$(wildcard host/bench_*.cpp))) \
+                 $(HOST_BUILD)/bench_demod_edge $(HOST_BUILD)/bench_demod_corr
+HOST_SNRS      = 20 12 8 6 4 2 0
+HOST_HEADERS   = $(wildcard *.h) $(wildcard host/*.h) $(wildcard host/include/*.h host/include/avr/*.h)
+
+.PHONY: host host-build host-bench host-clean
+
+host: host-build
+	@for t in $(HOST_TESTS); do $$t || exit 1; done
+
+host-build: $(HOST_TESTS)
+
+# Benchmarks: tab-separated tables on stdout
+host-bench: $(HOST_BENCHES)
+	@for b in $(filter-out %/bench_demod_edge %/bench_demod_corr,$(HOST_BENCHES)); do $$b || exit 1; done
+	@$(HOST_BUILD)/bench_demod_edge -h
+	@for d in edge corr; do for s in $(HOST_SNRS); do $(HOST_BUILD)/bench_demod_$$d $$s || exit 1; done; done
+
+host-clean:
+	rm -rf $(HOST_BUILD)
+
+$(HOST_BUILD)/%.o: %.cpp $(HOST_HEADERS)
+	@mkdir -p $(HOST_BUILD)
+	$(HOST_CXX) $(HOST_CXXFLAGS) -c -o $@ $<
+
+$(HOST_BUILD)/%.o: host/%.cpp $(HOST_HEADERS)
+	@mkdir -p $(HOST_BUILD)
+	$(HOST_CXX) $(HOST_CXXFLAGS) -c -o $@ $<
+
+$(HOST_BUILD)/test_%: $(HOST_BUILD)/test_%.o $(HOST_OBJS)
+	$(HOST_CXX) -o $@ $^ -lm
+
+$(HOST_BUILD)/bench_%: $(HOST_BUILD)/bench_%.o $(HOST_OBJS)
+	$(HOST_CXX) -o $@ $^ -lm
+# The DCF demodulator benchmark is built with each demodulator
+$(HOST_BUILD)/bench_demod_%.o: host/bench_demod.cpp $(HOST_HEADERS)
+	@mkdir -p $(HOST_BUILD)
+	$(HOST_CXX) $(HOST_CXXFLAGS) -DBENCH_DEMOD='"$*"' -c -o $@ $<
+
+$(HOST_BUILD)/dcfdecoder_corr.o: dcfdecoder.cpp $(HOST_HEADERS)
+	@mkdir -p $(HOST_BUILD)
+	$(HOST_CXX) $(HOST_CXXFLAGS) -DDcfDemod=DcfDemod_Correlate -c -o $@ $<
+
+$(HOST_BUILD)/bench_demod_edge: $(HOST_BUILD)/bench_demod_edge.o $(HOST_OBJS)
+	$(HOST_CXX) -o $@ $^ -lm
+
+$(HOST_BUILD)/bench_demod_corr: $(HOST_BUILD)/bench_demod_corr.o $(filter-out %/dcfdecoder.o,$(HOST_OBJS)) $(HOST_BUILD)/dcfdecoder_corr.o
+	$(HOST_CXX) -o $@ $^ -lm
+
+.SECONDARY:
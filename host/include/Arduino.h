@@ -0,0 +1,71 @@
+/* Arduino.h - host stand-in for the Arduino core
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#ifndef ARDUINO_H
+#define ARDUINO_H	1
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+#include <Print.h>
+
+#define HIGH			1
+#define LOW				0
+#define INPUT			0
+#define OUTPUT			1
+#define INPUT_PULLUP	2
+#define CHANGE			1
+#define FALLING			2
+#define RISING			3
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+// The pins, the time and the interrupts belong to the simulator (host/sim.cpp)
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+unsigned long millis(void);
+unsigned long micros(void);
+
+// The sketch
+void setup(void);
+void loop(void);
+
+#define F(s)	(reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+
+// Serial port: 64-byte transmit buffer at 115200 baud, like the real one
+class HardwareSerial : public Print
+{
+public:
+	void begin(unsigned long baud);
+	int available(void);
+	int read(void);
+	int availableForWrite(void);
+	size_t write(uint8_t c);
+};
+
+extern HardwareSerial Serial;
+
+#endif
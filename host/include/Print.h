@@ -0,0 +1,50 @@
+/* Print.h - host stand-in for the Arduino core's Print class
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#ifndef PRINT_H
+#define PRINT_H	1
+
+#include <stdint.h>
+#include <stddef.h>
+
+class __FlashStringHelper;
+
+// Base of everything that can be printed to. Derived classes provide write().
+class Print
+{
+public:
+	virtual size_t write(uint8_t c) = 0;
+	virtual void flush(void) { }
+	size_t print(const __FlashStringHelper *s);
+	size_t print(const char *s);
+	size_t print(char c);
+	size_t print(unsigned char v, int base = 10);
+	size_t print(int v, int base = 10);
+	size_t print(unsigned int v, int base = 10);
+	size_t print(long v, int base = 10);
+	size_t print(unsigned long v, int base = 10);
+	size_t println(const __FlashStringHelper *s);
+	size_t println(const char *s);
+	size_t println(unsigned int v, int base = 10);
+	size_t println(void);
+};
+
+#endif
@@ -0,0 +1,41 @@
+/* SPI.h - host stand-in for the Arduino SPI library
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#ifndef SPI_H
+#define SPI_H	1
+
+#include <stdint.h>
+
+#define MSBFIRST	1
+#define SPI_MODE0	0
+
+class SPIClass
+{
+public:
+	static void begin(void);
+	static void setBitOrder(uint8_t order);
+	static void setDataMode(uint8_t mode);
+	static uint8_t transfer(uint8_t data);
+};
+
+extern SPIClass SPI;
+
+#endif
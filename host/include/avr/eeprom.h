@@ -0,0 +1,34 @@
+/* avr/eeprom.h - host stand-in for avr-libc's EEPROM access
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#ifndef AVR_EEPROM_H
+#define AVR_EEPROM_H	1
+
+#include <stddef.h>
+
+// EEMEM variables are collected in their own section, which the simulator can erase
+// (sim_eeprom_erase()) to start with a blank EEPROM. Reading and writing copy to and from them.
+#define EEMEM	__attribute__((section("eeprom")))
+
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+
+#endif
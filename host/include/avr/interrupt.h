@@ -0,0 +1,33 @@
+/* avr/interrupt.h - host stand-in for avr-libc's interrupt macros
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#ifndef AVR_INTERRUPT_H
+#define AVR_INTERRUPT_H	1
+
+// The simulator delivers interrupts only while the clock is asleep, so there's nothing to lock.
+#define cli()		do { } while (0)
+#define sei()		do { } while (0)
+
+// ISRs are ordinary functions that the simulator calls by name
+#define ISR(v)				extern "C" void v(void)
+#define EMPTY_INTERRUPT(v)	extern "C" void v(void) { }
+
+#endif
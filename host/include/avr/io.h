@@ -0,0 +1,65 @@
+/* avr/io.h - host stand-in for the ATmega328p registers
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#ifndef AVR_IO_H
+#define AVR_IO_H	1
+
+#include <stdint.h>
+
+// Only the registers that the modules use directly. The pins (FastPin<>) are in fastpin.h.
+// TCNT2 and SPDR have side effects, so the simulator implements them as objects.
+
+class sim_tcnt2_t
+{
+public:
+	operator uint8_t() const;
+	sim_tcnt2_t &operator=(uint8_t v);
+};
+
+class sim_spdr_t
+{
+public:
+	operator uint8_t() const;
+	sim_spdr_t &operator=(uint8_t v);
+};
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t TCCR2A, TCCR2B, TIFR2, TIMSK2;
+extern volatile uint8_t EICRA, EIMSK, EIFR;
+extern sim_tcnt2_t TCNT2;
+extern volatile uint8_t SPCR, SPSR;
+extern sim_spdr_t SPDR;
+
+#define _BV(b)	(1u << (b))
+
+#define CS20	0
+#define CS21	1
+#define CS22	2
+#define TOV2	0
+#define TOIE2	0
+#define ISC00	0
+#define ISC01	1
+#define INT0	0
+#define INTF0	0
+#define SPIE	7
+#define SPE		6
+
+#endif
@@ -0,0 +1,43 @@
+/* avr/pgmspace.h - host stand-in for avr-libc's flash access
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#ifndef AVR_PGMSPACE_H
+#define AVR_PGMSPACE_H	1
+
+#include <stdint.h>
+#include <string.h>
+
+// The host has only one address space
+#define PROGMEM
+#define PSTR(s)				(s)
+#define pgm_read_byte(a)	(*(const uint8_t *)(a))
+#define memcpy_P			memcpy
+#define strlen_P			strlen
+#define strncmp_P			strncmp
+
+static inline uint16_t pgm_read_word(const void *a)
+{
+	uint16_t w;
+	memcpy(&w, a, sizeof(w));
+	return w;
+}
+
+#endif
@@ -0,0 +1,637 @@
+/* sim.cpp - simulated Arduino Nano for running the clock on the host
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <ucontext.h>
+#include <Arduino.h>
+#include <SPI.h>
+#include <avr/eeprom.h>
+#include "tasker.h"
+#include "displaydriver.h"
+#include "sim.h"
+
+// The modules' interrupt handlers. Weak, so that a test can leave a module out.
+extern "C" void INT0_vect(void) __attribute__((weak));
+extern "C" void TIMER2_OVF_vect(void) __attribute__((weak));
+extern "C" void SPI_STC_vect(void) __attribute__((weak));
+extern "C" void PCINT0_vect(void) __attribute__((weak));
+extern "C" void PCINT1_vect(void) __attribute__((weak));
+extern "C" void PCINT2_vect(void) __attribute__((weak));
+
+// EEMEM variables (see host/include/avr/eeprom.h)
+extern char __start_eeprom[] __attribute__((weak));
+extern char __stop_eeprom[] __attribute__((weak));
+
+#define SIM_NSOURCES	16
+#define SIM_STACK		(256*1024)
+#define SIM_BYTE_US		87				// One character at 115200 baud
+#define SIM_TXBUF		63				// Room in the Arduino core's transmit buffer
+#define SIM_RX_LEN		4096
+#define SIM_LATCH_LEDS	9				// SrLatch1 in displaydriver.cpp
+#define SIM_LATCH_DIGITS	10			// SrLatch4
+
+simtime_t sim_now;
+double sim_tick_error;
+unsigned char sim_busy;
+unsigned long sim_wakeups;
+unsigned long sim_interrupts;
+unsigned char sim_timer0;
+
+// Registers
+volatile uint8_t SREG;
+volatile uint8_t TCCR2A, TCCR2B, TIFR2, TIMSK2;
+volatile uint8_t EICRA, EIMSK, EIFR;
+sim_tcnt2_t TCNT2;
+volatile uint8_t SPCR, SPSR;
+sim_spdr_t SPDR;
+
+HardwareSerial Serial;
+SPIClass SPI;
+
+static void sim_set_time(simtime_t t);
+
+/* The clock runs in its own context, so that sim_run() can return to the test in the middle of
+ * taskerRun() and carry on from there the next time.
+*/
+static ucontext_t sim_main_ctx;
+static ucontext_t sim_clock_ctx;
+static char sim_stack[SIM_STACK];
+static unsigned char sim_started;
+static simtime_t sim_until;
+
+static void sim_clock_main(void)
+{
+	setup();							// Runs the tasker for ever
+	fprintf(stderr, "sim: setup() returned\n");
+	exit(2);
+}
+
+void sim_run(simtime_t until)
+{
+	sim_until = until;
+
+	if ( !sim_started )
+	{
+		sim_started = 1;
+		sim_eeprom_erase();
+		getcontext(&sim_clock_ctx);
+		sim_clock_ctx.uc_stack.ss_sp = sim_stack;
+		sim_clock_ctx.uc_stack.ss_size = sizeof(sim_stack);
+		sim_clock_ctx.uc_link = 0;
+		makecontext(&sim_clock_ctx, sim_clock_main, 0);
+	}
+
+	swapcontext(&sim_main_ctx, &sim_clock_ctx);
+}
+
+// sim_wait_until() - if time t is beyond the end of the run, return to the test until it calls
+// sim_run() again. Returns 1 if it did: the test may have added events in the meantime.
+static unsigned char sim_wait_until(simtime_t t)
+{
+	if ( t <= sim_until )
+		return 0;
+	sim_set_time(sim_until);
+	swapcontext(&sim_clock_ctx, &sim_main_ctx);
+	return 1;
+}
+
+/* Event sources
+*/
+typedef struct
+{
+	simsource_t fn;
+	simtime_t t;
+} simsrc_t;
+
+static simsrc_t sim_sources[SIM_NSOURCES];
+static int sim_nsources;
+
+void sim_source(simsource_t fn, simtime_t first)
+{
+	if ( sim_nsources >= SIM_NSOURCES )
+	{
+		fprintf(stderr, "sim: too many sources\n");
+		exit(2);
+	}
+	sim_sources[sim_nsources].fn = fn;
+	sim_sources[sim_nsources].t = first;
+	sim_nsources++;
+}
+
+void sim_source_at(simsource_t fn, simtime_t t)
+{
+	for ( int i = 0; i < sim_nsources; i++ )
+	{
+		if ( sim_sources[i].fn == fn )
+			sim_sources[i].t = t;
+	}
+}
+
+static simtime_t sim_next_event(void)
+{
+	simtime_t e = SIM_NEVER;
+	for ( int i = 0; i < sim_nsources; i++ )
+	{
+		if ( sim_sources[i].t < e )
+			e = sim_sources[i].t;
+	}
+	return e;
+}
+
+static void sim_run_events(simtime_t t)
+{
+	for ( int i = 0; i < sim_nsources; i++ )
+	{
+		if ( sim_sources[i].t <= t )
+		{
+			simtime_t next = sim_sources[i].fn(t);
+			sim_sources[i].t = ( next > t ) ? next : SIM_NEVER;
+		}
+	}
+}
+
+/* Timer 2: 16 MHz/1024 = 64 us per count, overflow interrupt every 256 counts
+*/
+static simtime_t sim_t2_base;			// Time at which TCNT2 was 0
+static unsigned long sim_t2_ovf;		// Overflows since then
+
+sim_tcnt2_t::operator uint8_t() const
+{
+	return (uint8_t)((sim_now - sim_t2_base) / 64);
+}
+
+sim_tcnt2_t &sim_tcnt2_t::operator=(uint8_t v)
+{
+	sim_t2_base = sim_now - (simtime_t)v * 64;
+	sim_t2_ovf = 0;
+	return *this;
+}
+
+// sim_set_time() - move the time on, running the timer interrupts that fall due on the way
+static void sim_set_time(simtime_t t)
+{
+	if ( t < sim_now )
+		return;
+	if ( sim_timer0 )
+		sim_interrupts += t / 1024 - sim_now / 1024;
+	sim_now = t;
+
+	if ( (TCCR2B & 0x07) != 0 )
+	{
+		unsigned long n = (unsigned long)((t - sim_t2_base) / 64 / 256);
+		while ( sim_t2_ovf < n )
+		{
+			sim_t2_ovf++;
+			if ( (TIMSK2 & _BV(TOIE2)) != 0 && TIMER2_OVF_vect != 0 )
+			{
+				sim_interrupts++;
+				TIMER2_OVF_vect();
+			}
+		}
+	}
+}
+
+// sim_advance() - let the time pass up to target, running the event sources on the way.
+// If wake is 1, return early after an event that notifies a task (the CPU wakes up).
+void sim_advance(simtime_t target, unsigned char wake)
+{
+	for (;;)
+	{
+		simtime_t e = sim_next_event();
+		simtime_t t = ( e < target ) ? e : target;
+
+		if ( sim_wait_until(t) )
+		{
+			if ( wake && taskerWakePending() )
+				return;					// The test called something that notified a task
+			continue;
+		}
+		sim_set_time(t);
+
+		if ( e == t )
+		{
+			sim_run_events(t);
+			sim_service();
+			if ( wake && taskerWakePending() )
+				return;
+		}
+		if ( t >= target )
+			return;
+	}
+}
+
+/* SPI and the display
+ *
+ * The five shift registers are in a chain: the byte sent first ends up at the far end (digit 0),
+ * the byte sent last in the extra LEDs. A rising edge on a latch pin copies the registers to the
+ * outputs, which are active low.
+*/
+unsigned char sim_leds[5];
+unsigned long sim_spi_bytes;
+static unsigned char sim_sr[5];
+static unsigned char sim_spi_pending;	// SPIF: transfer complete
+
+static void sim_shift(uint8_t b)
+{
+	for ( int i = 0; i < 4; i++ )
+		sim_sr[i] = sim_sr[i+1];
+	sim_sr[4] = b;
+	sim_spi_bytes++;
+}
+
+sim_spdr_t::operator uint8_t() const
+{
+	return 0xff;						// MISO isn't connected
+}
+
+sim_spdr_t &sim_spdr_t::operator=(uint8_t v)
+{
+	sim_shift(v);
+	sim_spi_pending = 1;				// A transfer only takes 2 us; it's complete at the next interrupt point
+	return *this;
+}
+
+void SPIClass::begin(void)				{ }
+void SPIClass::setBitOrder(uint8_t)		{ }
+void SPIClass::setDataMode(uint8_t)		{ }
+
+uint8_t SPIClass::transfer(uint8_t v)
+{
+	sim_shift(v);
+	return 0xff;
+}
+
+// sim_service() - deliver the interrupts that became pending while the clock was running
+void sim_service(void)
+{
+	while ( sim_spi_pending && (SPCR & _BV(SPIE)) != 0 && SPI_STC_vect != 0 )
+	{
+		sim_spi_pending = 0;
+		sim_interrupts++;
+		SPI_STC_vect();
+	}
+}
+
+static const unsigned char sim_7seg[10] =
+{	chargen_0, chargen_1, chargen_2, chargen_3, chargen_4,
+	chargen_5, chargen_6, chargen_7, chargen_8, chargen_9
+};
+
+char sim_digit(unsigned char i)
+{
+	unsigned char segs = sim_leds[i] & ~seg_dp;
+
+	if ( segs == 0 )
+		return ' ';
+	for ( int d = 0; d < 10; d++ )
+	{
+		if ( segs == sim_7seg[d] )
+			return '0' + d;
+	}
+	return '?';
+}
+
+const char *sim_display_text(void)
+{
+	static char text[5];
+	for ( int i = 0; i < 4; i++ )
+		text[i] = sim_digit(i);
+	text[4] = '\0';
+	return text;
+}
+
+/* Pins
+*/
+typedef struct
+{
+	unsigned char mode;
+	unsigned char out;					// Level written
+	unsigned char driven;				// The test drives the input
+	unsigned char in;					// ... to this level
+	unsigned char pcint;				// Pin-change interrupt enabled
+} simpin_t;
+
+static simpin_t sim_pins[SIM_NPINS];
+
+simpinwrite_t sim_trace[SIM_TRACE_LEN];
+unsigned sim_ntrace;
+unsigned long sim_pin_writes[SIM_NPINS];
+unsigned long sim_pin_rises[SIM_NPINS];
+
+void sim_trace_clear(void)
+{
+	sim_ntrace = 0;
+	for ( int i = 0; i < SIM_NPINS; i++ )
+	{
+		sim_pin_writes[i] = 0;
+		sim_pin_rises[i] = 0;
+	}
+}
+
+void sim_pin_mode(unsigned char pin, unsigned char mode)
+{
+	sim_pins[pin].mode = mode;
+}
+
+void sim_pin_write(unsigned char pin, unsigned char v)
+{
+	v = ( v != 0 );
+
+	if ( sim_ntrace < SIM_TRACE_LEN )
+	{
+		sim_trace[sim_ntrace].t = sim_now;
+		sim_trace[sim_ntrace].pin = pin;
+		sim_trace[sim_ntrace].level = v;
+		sim_ntrace++;
+	}
+	sim_pin_writes[pin]++;
+
+	if ( v && !sim_pins[pin].out )
+	{
+		sim_pin_rises[pin]++;
+		if ( pin == SIM_LATCH_DIGITS )
+		{
+			for ( int i = 0; i < 4; i++ )
+				sim_leds[i] = ~sim_sr[i];
+		}
+		else if ( pin == SIM_LATCH_LEDS )
+			sim_leds[4] = ~sim_sr[4];
+	}
+	sim_pins[pin].out = v;
+}
+
+unsigned char sim_pin_read(unsigned char pin)
+{
+	simpin_t *p = &sim_pins[pin];
+
+	if ( p->mode == OUTPUT )
+		return p->out;
+	if ( p->driven )
+		return p->in;
+	return ( p->mode == INPUT_PULLUP );
+}
+
+unsigned char sim_pin_level(unsigned char pin)
+{
+	return sim_pin_read(pin);
+}
+
+void sim_pin_pcint(unsigned char pin)
+{
+	sim_pins[pin].pcint = 1;
+}
+
+// sim_pin_input() - drive an input pin from a source. A change causes the pin's interrupts.
+void sim_pin_input(unsigned char pin, unsigned char level)
+{
+	unsigned char old = sim_pin_read(pin);
+
+	sim_pins[pin].driven = 1;
+	sim_pins[pin].in = ( level != 0 );
+
+	unsigned char now = sim_pin_read(pin);
+	if ( now == old )
+		return;
+
+	// INT0 on pin 2. EICRA's ISC0 field: 1 any change, 2 falling, 3 rising edge (0, low level, isn't used)
+	unsigned char isc0 = EICRA & (_BV(ISC01) | _BV(ISC00));
+	if ( pin == 2 && (EIMSK & _BV(INT0)) != 0 && INT0_vect != 0 &&
+		 ( isc0 == 1 || (isc0 == 2 && !now) || (isc0 == 3 && now) ) )
+	{
+		sim_interrupts++;
+		INT0_vect();
+	}
+
+	if ( sim_pins[pin].pcint )
+	{
+		void (*isr)(void) = ( pin < 8 ) ? PCINT2_vect : ( pin < 14 ) ? PCINT0_vect : PCINT1_vect;
+		if ( isr != 0 )
+		{
+			sim_interrupts++;
+			isr();
+		}
+	}
+}
+
+/* Scripted inputs, kept in time order
+*/
+#define SIM_NSCRIPT		256
+
+static simpinwrite_t sim_script[SIM_NSCRIPT];
+static unsigned sim_nscript;
+static unsigned char sim_script_started;
+
+static simtime_t sim_script_next(void)
+{
+	return ( sim_nscript > 0 ) ? sim_script[0].t : SIM_NEVER;
+}
+
+static simtime_t sim_script_source(simtime_t t)
+{
+	while ( sim_nscript > 0 && sim_script[0].t <= t )
+	{
+		simpinwrite_t w = sim_script[0];
+		sim_nscript--;
+		memmove(&sim_script[0], &sim_script[1], sim_nscript * sizeof(sim_script[0]));
+		sim_pin_input(w.pin, w.level);
+	}
+	return sim_script_next();
+}
+
+void sim_pin_at(simtime_t t, unsigned char pin, unsigned char level)
+{
+	if ( sim_nscript >= SIM_NSCRIPT )
+	{
+		fprintf(stderr, "sim: input script full\n");
+		exit(2);
+	}
+
+	unsigned i = sim_nscript;
+	while ( i > 0 && sim_script[i-1].t > t )
+	{
+		sim_script[i] = sim_script[i-1];
+		i--;
+	}
+	sim_script[i].t = t;
+	sim_script[i].pin = pin;
+	sim_script[i].level = level;
+	sim_nscript++;
+
+	if ( !sim_script_started )
+	{
+		sim_script_started = 1;
+		sim_source(sim_script_source, sim_script_next());
+	}
+	else
+		sim_source_at(sim_script_source, sim_script_next());
+}
+
+void sim_press(unsigned char pin, simtime_t t, simtime_t length)
+{
+	sim_pin_at(t, pin, LOW);
+	sim_pin_at(t + length, pin, HIGH);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)		{ sim_pin_mode(pin, mode); }
+void digitalWrite(uint8_t pin, uint8_t val)	{ sim_pin_write(pin, val); }
+int digitalRead(uint8_t pin)				{ return sim_pin_read(pin); }
+
+unsigned long millis(void)	{ return (unsigned long)(sim_now / 1000); }
+unsigned long micros(void)	{ return (unsigned long)sim_now; }
+
+/* Serial port
+*/
+unsigned char sim_tx[SIM_TX_LEN];
+unsigned sim_ntx;
+unsigned long sim_tx_stalls;
+static simtime_t sim_tx_done;			// Time at which the UART will have sent everything
+static char sim_rx[SIM_RX_LEN];
+static unsigned sim_rx_head;
+static unsigned sim_rx_tail;
+
+void sim_serial_input(const char *s)
+{
+	while ( *s != '\0' && sim_rx_head < SIM_RX_LEN )
+		sim_rx[sim_rx_head++] = *s++;
+}
+
+void sim_serial_clear(void)
+{
+	sim_ntx = 0;
+}
+
+static int sim_tx_level(void)
+{
+	if ( sim_tx_done <= sim_now )
+		return 0;
+	return (int)((sim_tx_done - sim_now + SIM_BYTE_US - 1) / SIM_BYTE_US);
+}
+
+void HardwareSerial::begin(unsigned long)
+{
+}
+
+int HardwareSerial::available(void)
+{
+	return sim_rx_head - sim_rx_tail;
+}
+
+int HardwareSerial::read(void)
+{
+	if ( sim_rx_tail >= sim_rx_head )
+		return -1;
+	return (unsigned char)sim_rx[sim_rx_tail++];
+}
+
+int HardwareSerial::availableForWrite(void)
+{
+	int n = SIM_TXBUF - sim_tx_level();
+	return ( n > 0 ) ? n : 0;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+	if ( sim_tx_level() >= SIM_TXBUF )
+		sim_tx_stalls++;				// The real one would wait here
+	sim_tx_done = (( sim_tx_done > sim_now ) ? sim_tx_done : sim_now) + SIM_BYTE_US;
+	if ( sim_ntx < SIM_TX_LEN )
+		sim_tx[sim_ntx++] = c;
+	return 1;
+}
+
+static size_t sim_print(Print *p, const char *s)
+{
+	size_t n = 0;
+	while ( *s != '\0' )
+		n += p->write(*s++);
+	return n;
+}
+
+static size_t sim_printnum(Print *p, unsigned long long v, int neg, int base)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), ( base == 16 ) ? "%s%llx" : "%s%llu", neg ? "-" : "", v);
+	return sim_print(p, buf);
+}
+
+size_t Print::print(const __FlashStringHelper *s)	{ return sim_print(this, (const char *)s); }
+size_t Print::print(const char *s)					{ return sim_print(this, s); }
+size_t Print::print(char c)							{ return write(c); }
+size_t Print::print(unsigned char v, int base)		{ return sim_printnum(this, v, 0, base); }
+size_t Print::print(unsigned int v, int base)		{ return sim_printnum(this, v, 0, base); }
+size_t Print::print(unsigned long v, int base)		{ return sim_printnum(this, v, 0, base); }
+size_t Print::print(int v, int base)				{ return sim_printnum(this, v < 0 ? -(long long)v : v, v < 0, base); }
+size_t Print::print(long v, int base)				{ return sim_printnum(this, v < 0 ? -(long long)v : v, v < 0, base); }
+size_t Print::println(const __FlashStringHelper *s)	{ return print(s) + println(); }
+size_t Print::println(const char *s)				{ return print(s) + println(); }
+size_t Print::println(unsigned int v, int base)		{ return print(v, base) + println(); }
+size_t Print::println(void)							{ return sim_print(this, "\r\n"); }
+
+/* EEPROM
+*/
+unsigned long sim_eeprom_writes;
+
+void sim_eeprom_erase(void)
+{
+	if ( __start_eeprom != 0 )
+		memset(__start_eeprom, 0xff, __stop_eeprom - __start_eeprom);
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+	memcpy(dst, src, n);
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+	if ( memcmp(dst, src, n) != 0 )
+		sim_eeprom_writes++;
+	memcpy(dst, src, n);
+}
+
+/* Checks
+*/
+int sim_failures;
+
+void sim_fail(const char *file, int line, const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s:%d: at %.3f s: ", file, line, sim_now / 1e6);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	sim_failures++;
+}
+
+int sim_report(const char *name)
+{
+	if ( sim_failures != 0 )
+	{
+		printf("%s: %d failure(s)\n", name, sim_failures);
+		return 1;
+	}
+	printf("%s: ok\n", name);
+	return 0;
+}
@@ -0,0 +1,107 @@
+/* sim.h - simulated Arduino Nano for running the clock on the host
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#ifndef SIM_H
+#define SIM_H	1
+
+/* The whole sketch (setup() and all the tasks) runs on a simulated time base. When the tasker goes
+ * to sleep, the simulated clock jumps straight to the next task deadline or to the next event,
+ * whichever comes first, so a year of operation takes seconds. Events are the simulator's
+ * interrupts: a test registers sources that change the input pins (DCF signal, buttons) at
+ * given times.
+ *
+ * A test calls sim_run() to let the clock run up to a given time, then looks at the display,
+ * the pins, the serial output or the modules' variables, and carries on.
+*/
+
+typedef unsigned long long simtime_t;	// Microseconds since the start
+#define SIM_NEVER		(~(simtime_t)0)
+#define SIM_MS(x)		((simtime_t)(x) * 1000)
+#define SIM_S(x)		((simtime_t)(x) * 1000000)
+
+extern simtime_t sim_now;
+
+// Running the clock
+extern void sim_run(simtime_t until);	// Start setup() (the first time) and run until the time
+extern double sim_tick_error;			// Fractional error of the time base (1e-4: 100 ppm fast)
+extern unsigned char sim_busy;			// 1: the idle function polls instead of sleeping
+extern unsigned long sim_wakeups;		// Wakeups from sleep (each poll when sim_busy)
+extern unsigned long sim_interrupts;	// Interrupts delivered (including those that didn't wake a task)
+extern unsigned char sim_timer0;		// 1: timer 0 overflows every 1024 us, for micros()
+
+// Event sources. fn is called at time t, like an interrupt, and returns the time of its next call.
+typedef simtime_t (*simsource_t)(simtime_t t);
+extern void sim_source(simsource_t fn, simtime_t first);
+extern void sim_source_at(simsource_t fn, simtime_t t);	// Change the time of a source's next call
+
+// Pins (Arduino numbering). Inputs that aren't driven read as their pull-up.
+#define SIM_NPINS		20
+extern void sim_pin_input(unsigned char pin, unsigned char level);
+extern unsigned char sim_pin_level(unsigned char pin);
+
+// Scripted inputs: drive the pin to the level at time t (buttons are active low)
+extern void sim_pin_at(simtime_t t, unsigned char pin, unsigned char level);
+extern void sim_press(unsigned char pin, simtime_t t, simtime_t length);
+
+typedef struct
+{
+	simtime_t t;
+	unsigned char pin;
+	unsigned char level;
+} simpinwrite_t;
+
+#define SIM_TRACE_LEN	1024			// The latest writes to output pins, oldest first
+extern simpinwrite_t sim_trace[SIM_TRACE_LEN];
+extern unsigned sim_ntrace;
+extern unsigned long sim_pin_writes[SIM_NPINS];	// Writes to each pin
+extern unsigned long sim_pin_rises[SIM_NPINS];	// Low-to-high changes of each pin
+extern void sim_trace_clear(void);
+
+// The display: the shift registers behind the latches on pins 9 (extra LEDs) and 10 (digits)
+extern unsigned char sim_leds[5];		// Segments that are lit, as in display[]
+extern unsigned long sim_spi_bytes;		// Bytes shifted out
+extern char sim_digit(unsigned char i);	// Digit 0..3 as a character: '0'..'9', ' ' or '?'
+extern const char *sim_display_text(void);	// The four digits
+
+// Serial port
+extern void sim_serial_input(const char *s);
+#define SIM_TX_LEN		65536
+extern unsigned char sim_tx[SIM_TX_LEN];	// Everything written (until full)
+extern unsigned sim_ntx;
+extern unsigned long sim_tx_stalls;		// Writes that would have waited for room in the buffer
+extern void sim_serial_clear(void);
+
+// EEPROM
+extern void sim_eeprom_erase(void);
+extern unsigned long sim_eeprom_writes;
+
+// For the simulated time base (simtimebase.cpp)
+extern void sim_advance(simtime_t target, unsigned char wake);	// wake: stop if a task is notified
+extern void sim_service(void);			// Deliver pending interrupts
+
+// Checks. A test returns sim_report() from main().
+extern int sim_failures;
+extern void sim_fail(const char *file, int line, const char *fmt, ...);
+extern int sim_report(const char *name);
+
+#define CHECK(c, ...)	do { if ( !(c) ) sim_fail(__FILE__, __LINE__, __VA_ARGS__); } while (0)
+
+#endif
@@ -0,0 +1,177 @@
+/* simdcf.cpp - DCF77 signal for the host tests
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "simdcf.h"
+
+#define DCF_PIN			2
+#define DCF_PON_PIN		4
+#define DCF_STEP		SIM_MS(5)		// Noise sample interval
+#define DCF_NOISE_TAU	10.0			// Noise correlation time (ms)
+
+// Written from the table in README.md rather than from dcfdecoder.cpp, so that the tests
+// don't share the decoder's mistakes.
+
+static void put(char *bits, int first, int n, unsigned v)
+{
+	for ( int i = 0; i < n; i++ )
+		bits[first + i] = ( (v >> i) & 1 ) ? '1' : '0';
+}
+
+static unsigned bcd(unsigned v)
+{
+	return ((v / 10) << 4) | (v % 10);
+}
+
+static char parity(const char *bits, int first, int last)
+{
+	int p = 0;
+	for ( int i = first; i <= last; i++ )
+		p ^= ( bits[i] == '1' );
+	return p ? '1' : '0';
+}
+
+void sim_dcf_encode(char *bits, unsigned y, unsigned mo, unsigned d, unsigned h, unsigned mi, int cest)
+{
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = y - 1900;
+	tm.tm_mon = mo - 1;
+	tm.tm_mday = d;
+	tm.tm_hour = 12;
+	time_t t = timegm(&tm);
+	gmtime_r(&t, &tm);
+
+	memset(bits, '0', SIM_DCF_BITS);
+	bits[SIM_DCF_BITS] = '\0';
+
+	bits[17] = cest ? '1' : '0';		// Z1
+	bits[18] = cest ? '0' : '1';		// Z2
+	bits[20] = '1';						// S
+	put(bits, 21, 7, bcd(mi));
+	bits[28] = parity(bits, 21, 27);
+	put(bits, 29, 6, bcd(h));
+	bits[35] = parity(bits, 29, 34);
+	put(bits, 36, 6, bcd(d));
+	put(bits, 42, 3, ( tm.tm_wday == 0 ) ? 7 : tm.tm_wday);
+	put(bits, 45, 5, bcd(mo));
+	put(bits, 50, 8, bcd(y % 100));
+	bits[58] = parity(bits, 36, 57);
+}
+
+/* The signal source
+*/
+static simtime_t dcf_first;				// Sim time of the first minute
+static long long dcf_minute0;			// ... and its time (seconds since 1970)
+static long long dcf_minute = -1;		// Minute of the frame in dcf_bits
+static char dcf_bits[SIM_DCF_BITS + 1];
+static double dcf_sigma;				// rms noise
+static double dcf_noise;				// Filtered noise
+static unsigned dcf_rand;
+static unsigned char dcf_level;
+unsigned long sim_dcf_flips;
+
+// Uniform (0,1) and normal random numbers, the same sequence on every host
+static double dcf_uniform(void)
+{
+	dcf_rand ^= dcf_rand << 13;
+	dcf_rand ^= dcf_rand >> 17;
+	dcf_rand ^= dcf_rand << 5;
+	return (dcf_rand + 0.5) / 4294967296.0;
+}
+
+static double dcf_normal(void)
+{
+	return sqrt(-2.0 * log(dcf_uniform())) * cos(2.0 * M_PI * dcf_uniform());
+}
+
+// dcf_frame() - encode the frame sent during the minute that starts at the given time
+static void dcf_frame(long long minute)
+{
+	time_t t = (time_t)(minute + 60);	// The frame gives the time of the next minute
+	struct tm tm;
+	gmtime_r(&t, &tm);
+	sim_dcf_encode(dcf_bits, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, 0);
+	dcf_minute = minute;
+}
+
+static simtime_t dcf_source(simtime_t t)
+{
+	simtime_t since = t - dcf_first;
+	long long minute = dcf_minute0 + (long long)(since / SIM_S(60)) * 60;
+	unsigned sec = (unsigned)((since / SIM_S(1)) % 60);
+	unsigned ms = (unsigned)((since / SIM_MS(1)) % 1000);
+
+	if ( minute != dcf_minute )
+		dcf_frame(minute);
+
+	double s = -1.0;
+	if ( sec < SIM_DCF_BITS && ms < ( dcf_bits[sec] == '1' ? 200 : 100 ) )
+		s = 1.0;
+
+	double a = exp(-(double)DCF_STEP / 1000.0 / DCF_NOISE_TAU);
+	dcf_noise = a * dcf_noise + sqrt(1.0 - a * a) * dcf_sigma * dcf_normal();
+
+	unsigned char level = ( s + dcf_noise > 0.0 );
+	if ( sim_pin_level(DCF_PON_PIN) )
+		level = 0;						// Receiver off
+	else if ( level != ( s > 0.0 ) && level != dcf_level )
+		sim_dcf_flips++;
+
+	if ( level != dcf_level )
+	{
+		dcf_level = level;
+		sim_pin_input(DCF_PIN, level);
+	}
+	return t + DCF_STEP;
+}
+
+void sim_dcf_start(simtime_t first, long long start_minute, double snr_db, unsigned seed)
+{
+	dcf_first = first;
+	dcf_minute0 = start_minute;
+	dcf_sigma = pow(10.0, -snr_db / 20.0);
+	dcf_rand = seed | 1;
+	dcf_level = 0;
+	sim_pin_input(DCF_PIN, 0);
+	dcf_frame(start_minute);
+	sim_source(dcf_source, first);
+}
+
+void sim_dcf_stop(void)
+{
+	if ( dcf_level )
+		sim_pin_input(DCF_PIN, 0);
+	dcf_level = 0;
+	sim_source_at(dcf_source, SIM_NEVER);
+}
+
+void sim_dcf_resume(void)
+{
+	sim_source_at(dcf_source, sim_now + DCF_STEP);
+}
+
+const char *sim_dcf_sent(void)
+{
+	return dcf_bits;
+}
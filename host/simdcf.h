@@ -0,0 +1,45 @@
+/* simdcf.h - DCF77 signal for the host tests
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#ifndef SIMDCF_H
+#define SIMDCF_H	1
+
+#include "sim.h"
+
+#define SIM_DCF_BITS	59
+
+// sim_dcf_encode() - the frame sent during the minute before y-mo-d h:mi, as '0' and '1'
+// characters (bit 0 first, nul-terminated). The day of the week comes from the C library.
+extern void sim_dcf_encode(char *bits, unsigned y, unsigned mo, unsigned d, unsigned h, unsigned mi, int cest);
+
+/* The receiver output on pin 2: high for 100 ms (0) or 200 ms (1) at the start of each second,
+ * no pulse in second 59. The time sent starts at the given minute (UTC, as for gmtime()) at
+ * sim time first. Noise is added before the receiver's comparator: Gaussian, low-pass filtered
+ * (10 ms), with the signal-to-noise ratio in dB (amplitude of the pulse over the rms noise).
+ * The output stays low while the receiver is off (PON pin 4 high).
+*/
+extern void sim_dcf_start(simtime_t first, long long start_minute, double snr_db, unsigned seed);
+extern void sim_dcf_stop(void);				// Signal lost: the receiver output stays low
+extern void sim_dcf_resume(void);
+extern const char *sim_dcf_sent(void);		// The frame being sent in the current minute
+extern unsigned long sim_dcf_flips;			// Comparator changes caused by the noise
+
+#endif
@@ -0,0 +1,79 @@
+/* simtimebase.cpp - simulated time base for the host build
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <Arduino.h>
+#include "dcfclock.h"
+#include "tasker.h"
+#include "sim.h"
+
+// Replaces timebase.cpp. ReadTime() counts ticks of the simulated time source, which can be made
+// fast or slow with sim_tick_error. IdleSleep() lets the simulated time jump to the deadline.
+
+#define SIM_TICK_US		(1000000.0 / Ticks(1000))	// Nominal length of a ReadTime() tick
+#define SIM_POLL_US		10							// One pass of a busy loop (sim_busy)
+
+static double tick_len(void)
+{
+	return SIM_TICK_US / (1.0 + sim_tick_error);
+}
+
+// tick_start() - the time at which ReadTime() reaches tick
+static simtime_t tick_start(unsigned long tick)
+{
+	simtime_t t = (simtime_t)(tick * tick_len());
+
+	while ( (unsigned long)(t / tick_len()) < tick )
+		t++;
+	return t;
+}
+
+void TimebaseInit(void)
+{
+	// As in timebase.cpp: the task statistics need timer 0 for micros()
+	sim_timer0 = TASKER_STATS;
+}
+
+unsigned long ReadTime(void)
+{
+	return (unsigned long)(sim_now / tick_len());
+}
+
+// IdleSleep() - sleep until wakeTime or until an interrupt notifies a task
+// With sim_busy set it only lets one pass of a busy loop go by, like the tasker without an idle function.
+void IdleSleep(unsigned long wakeTime)
+{
+	sim_service();
+	if ( taskerWakePending() )
+		return;
+
+	if ( sim_busy )
+	{
+		sim_advance(sim_now + SIM_POLL_US, 0);
+		sim_wakeups++;
+		return;
+	}
+
+	if ( (long)(wakeTime - ReadTime()) <= 0 )
+		return;
+
+	sim_advance(tick_start(wakeTime), 1);
+	sim_wakeups++;
+}
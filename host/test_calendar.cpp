@@ -0,0 +1,102 @@
+/* test_calendar.cpp - check the calendar module for every day from 1900 to 2399
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include <time.h>
+#include "calendar.h"
+#include "sim.h"
+
+// The reference walks through the days one at a time, the way the old code did, and the day of
+// the week is also compared with the C library. The clock isn't started.
+
+#define FIRST_YEAR	1900
+#define LAST_YEAR	2399
+#define DAYNO_1900	(-36524L)		// 1900-01-01 from 2000-01-01: 100 years with 24 leap days
+
+// Reference: the Gregorian rule spelled out, and a table of month lengths
+static int ref_leap(int y)
+{
+	return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+static int ref_monthlength(int m, int y)
+{
+	static const int len[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	return len[m - 1] + ( m == 2 && ref_leap(y) );
+}
+
+int main(void)
+{
+	long dayno = DAYNO_1900;
+	int dow = 1;						// 1900-01-01 was a Monday
+	unsigned long days = 0;
+
+	for ( int y = FIRST_YEAR; y <= LAST_YEAR; y++ )
+	{
+		CHECK(isleap(y) == ref_leap(y), "isleap(%d)", y);
+		CHECK(days_since_epoch(y) == dayno, "days_since_epoch(%d) = %ld, expected %ld", y, days_since_epoch(y), dayno);
+
+		int yday = 0;
+		for ( int m = 1; m <= 12; m++ )
+		{
+			CHECK(monthlength(m - 1, y) == ref_monthlength(m, y), "monthlength(%d, %d)", m - 1, y);
+
+			for ( int d = 1; d <= ref_monthlength(m, y); d++ )
+			{
+				unsigned char cm, cd;
+				unsigned cy, cyday;
+
+				CHECK(date_to_yday(y, m, d) == (unsigned)yday, "date_to_yday(%d-%02d-%02d) = %u, expected %d",
+						y, m, d, date_to_yday(y, m, d), yday);
+
+				yday_to_date(y, yday, &cm, &cd);
+				CHECK(cm == m && cd == d, "yday_to_date(%d, %d) = %u-%u, expected %d-%d", y, yday, cm, cd, m, d);
+
+				epoch_days_to_year(dayno, &cy, &cyday);
+				CHECK(cy == (unsigned)y && cyday == (unsigned)yday, "epoch_days_to_year(%ld) = %u/%u, expected %d/%d",
+						dayno, cy, cyday, y, yday);
+
+				CHECK(day_of_week(dayno) == dow, "day_of_week(%d-%02d-%02d) = %u, expected %d",
+						y, m, d, day_of_week(dayno), dow);
+
+				dayno++;
+				yday++;
+				dow = ( dow == 7 ) ? 1 : dow + 1;
+				days++;
+
+				if ( sim_failures > 20 )
+					return sim_report("test_calendar");
+			}
+		}
+	}
+
+	// Spot checks of the day of the week against the C library
+	for ( long n = DAYNO_1900; n < dayno; n += 997 )
+	{
+		time_t t = (time_t)(n + 10957) * 86400;	// 10957 days from 1970 to 2000
+		struct tm tm;
+		gmtime_r(&t, &tm);
+		CHECK(day_of_week(n) == ( tm.tm_wday == 0 ? 7 : tm.tm_wday ), "day_of_week(%ld) disagrees with gmtime()", n);
+	}
+
+	printf("test_calendar: %lu days, %d to %d\n", days, FIRST_YEAR, LAST_YEAR);
+	return sim_report("test_calendar");
+}
@@ -0,0 +1,119 @@
+/* test_clock.cpp - run the whole clock for a simulated year and check the display
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "sim.h"
+
+// The clock is set to 2023-12-31 23:59 over the console and runs to the end of 2024, a leap year.
+// Every hour the hh:mm display is compared with gmtime(). Every day at noon the Mode button is
+// pressed to show DDMM and YYYY, then the display is left to time out back to hh:mm.
+
+#define MODE_PIN	8
+#define T_SET		SIM_S(2)		// The set command is sent at this time (executed within 0.1 s)
+#ifndef N_HOURS
+#define N_HOURS		(367 * 24)
+#endif
+
+static time_t ref_epoch;			// Time set in the clock
+
+// expected() - format the reference time at sim time t as the display would show it
+static void expected(simtime_t t, const char *fmt, char *buf)
+{
+	time_t now = ref_epoch + (time_t)((t - T_SET) / 1000000);
+	struct tm tm;
+
+	gmtime_r(&now, &tm);
+	strftime(buf, 8, fmt, &tm);
+	if ( fmt[1] == 'H' && buf[0] == '0' )
+		buf[0] = ' ';					// Leading zero of the hours isn't shown
+}
+
+static void check_display(const char *fmt, const char *what)
+{
+	char exp[8];
+
+	expected(sim_now, fmt, exp);
+	CHECK(strcmp(sim_display_text(), exp) == 0, "%s: display \"%s\", expected \"%s\"", what, sim_display_text(), exp);
+}
+
+// press_mode() - press and release the Mode button, then let the clock run for a second
+static void press_mode(void)
+{
+	sim_press(MODE_PIN, sim_now, SIM_MS(100));
+	sim_run(sim_now + SIM_S(1));
+}
+
+int main(void)
+{
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = 2023 - 1900;
+	tm.tm_mon = 11;
+	tm.tm_mday = 31;
+	tm.tm_hour = 23;
+	tm.tm_min = 59;
+	ref_epoch = timegm(&tm);
+
+	sim_run(T_SET);
+	sim_serial_input("set 2023-12-31 23:59\r");
+
+	unsigned leap_days = 0;
+	unsigned years = 0;
+
+	for ( unsigned h = 0; h < N_HOURS; h++ )
+	{
+		// 90 s after the set command and on the hour after that: hh:mm is 00:00:30 + h hours
+		sim_run(T_SET + SIM_S(90) + SIM_S(3600) * h);
+		check_display("%H%M", "hh:mm");
+
+		if ( (h % 24) == 12 )
+		{
+			char date[8];
+
+			press_mode();
+			press_mode();
+			check_display("%d%m", "DDMM");
+			expected(sim_now, "%d%m", date);
+			if ( strcmp(date, "2802") == 0 || strcmp(date, "2902") == 0 || strcmp(date, "0103") == 0 )
+			{
+				CHECK(strcmp(sim_display_text(), date) == 0, "leap year: %s", date);
+				leap_days++;
+			}
+
+			press_mode();
+			check_display("%Y", "YYYY");
+			if ( strcmp(sim_display_text(), "2024") == 0 || strcmp(sim_display_text(), "2025") == 0 )
+				years |= ( sim_display_text()[3] == '4' ) ? 1 : 2;
+
+			sim_run(sim_now + SIM_S(6));
+			check_display("%H%M", "hh:mm after timeout");
+		}
+	}
+
+	CHECK(leap_days == 3, "saw %u of 28.02, 29.02 and 01.03", leap_days);
+	CHECK(years == 3, "didn't see both 2024 and 2025 (%u)", years);
+
+	printf("test_clock: %.1f simulated days, %lu wakeups, %lu interrupts\n",
+			sim_now / 86400e6, sim_wakeups, sim_interrupts);
+	return sim_report("test_clock");
+}
@@ -0,0 +1,177 @@
+/* test_console.cpp - console commands and their replies in the telemetry stream
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "displaydriver.h"
+#include "telemetry.h"
+#include "dcfdecoder.h"
+#include "simdcf.h"
+
+// Commands are typed into the simulated serial port and the output is decoded as tools/tlmdecode.py
+// does it: every frame must be a valid record, and the replies are put together from TLM_TEXT records.
+// The host's unsigned is 32 bits, so a number that would wrap on the Nano is only checked for rejection.
+
+#define PIN_DOWN	7
+#define PIN_MODE	8
+
+static unsigned tx_pos;
+static unsigned bad_frames;
+static char text[1024];					// Text received since the last reply() call
+static unsigned text_len;
+
+// tlm_scan() - decode the new serial output, collecting the text
+static void tlm_scan(void)
+{
+	unsigned char rec[64];
+	unsigned start = tx_pos;
+
+	for ( unsigned i = tx_pos; i < sim_ntx; i++ )
+	{
+		if ( sim_tx[i] != 0 )
+			continue;
+
+		unsigned n = 0;
+		unsigned j = start;
+		int ok = 1;
+		while ( j < i )
+		{
+			unsigned code = sim_tx[j++];
+			if ( code == 0 || j + code - 1 > i || n + code > sizeof(rec) )
+			{
+				ok = 0;
+				break;
+			}
+			for ( unsigned k = 1; k < code; k++ )
+				rec[n++] = sim_tx[j++];
+			if ( j < i )
+				rec[n++] = 0;
+		}
+		start = i + 1;
+
+		if ( !ok || n < 3 || n > 3 + TLM_MAX_PAYLOAD )
+			bad_frames++;
+		else if ( rec[0] == TLM_TEXT )
+		{
+			for ( unsigned k = 3; k < n && text_len < sizeof(text) - 1; k++ )
+				text[text_len++] = rec[k];
+			text[text_len] = '\0';
+		}
+	}
+	tx_pos = start;
+}
+
+// command() - type a command line and return the text that comes back within a second
+static const char *command(const char *line)
+{
+	tlm_scan();
+	text_len = 0;
+	text[0] = '\0';
+
+	sim_serial_input(line);
+	sim_run(sim_now + SIM_S(1));
+	tlm_scan();
+	return text;
+}
+
+static void expect_reply(const char *line, const char *reply)
+{
+	const char *r = command(line);
+
+	CHECK(strcmp(r, reply) == 0, "\"%.*s\": reply \"%s\", expected \"%s\"", (int)strlen(line) - 1, line, r, reply);
+}
+
+int main(void)
+{
+	sim_run(SIM_S(2));
+	tlm_scan();
+	CHECK(strcmp(text, "dcfclock v0.2\r\nGPLv3 or later; see source for details\r\n") == 0, "banner \"%s\"", text);
+
+	// Replies
+	expect_reply("set 2024-02-29 23:58\r", "2024-02-29 23:58:00\r\n");
+	expect_reply("bogus\r", "?\r\n");
+	expect_reply("set 2024-02-30 23:58\r", "usage: set YYYY-MM-DD hh:mm\r\n");
+	expect_reply("set 67556-02-29 23:58\r", "usage: set YYYY-MM-DD hh:mm\r\n");
+	expect_reply("mode 65536\r", "usage: mode 0..4\r\n");
+	expect_reply("mode 5\r", "usage: mode 0..4\r\n");
+	expect_reply("0123456789012345678901234567890123456789\r", "?\r\n");
+
+	// Modes are selected as the Mode button does it
+	expect_reply("mode 1\r", "ok\r\n");
+	CHECK(display_mode == (state_normal | mode_mmss), "mode 1: display_mode 0x%02x", display_mode);
+	expect_reply("mode 4\r", "ok\r\n");
+	CHECK(display_mode == (state_normal | mode_xxx), "mode 4: display_mode 0x%02x", display_mode);
+	CHECK(display[0] == 0xff && display[1] == 0xff && display[2] == 0xff && display[3] == 0xff,
+		"mode 4: display not all on");
+	expect_reply("mode 0\r", "ok\r\n");
+	CHECK(display_mode == (state_normal | mode_hhmm), "mode 0: display_mode 0x%02x", display_mode);
+	CHECK(strcmp(sim_display_text(), "2358") == 0, "mode 0: display \"%s\"", sim_display_text());
+
+	// ... but not in setting state
+	sim_press(PIN_MODE, sim_now, SIM_MS(600));
+	sim_press(PIN_DOWN, sim_now + SIM_MS(200), SIM_MS(200));
+	sim_run(sim_now + SIM_S(1));
+	CHECK(display_mode == (state_setting | mode_hhmm), "Mode+Down: display_mode 0x%02x", display_mode);
+	expect_reply("mode 2\r", "setting in progress\r\n");
+	CHECK(display_mode == (state_setting | mode_hhmm), "mode 2 in setting: display_mode 0x%02x", display_mode);
+
+	// Several commands at once are answered in turn
+	sim_run(sim_now + SIM_S(15));		// Setting state times out
+	tlm_scan();
+	text_len = 0;
+	sim_serial_input("bogus\rmode 7\rbogus\r");
+	sim_run(sim_now + SIM_S(2));
+	tlm_scan();
+	CHECK(strcmp(text, "?\r\nusage: mode 0..4\r\n?\r\n") == 0, "three commands: \"%s\"", text);
+
+	// The host build has no task statistics
+	expect_reply("stats\r", "stats disabled (TASKER_STATS 0)\r\n");
+
+	// Two frames typed a minute apart synchronise the clock. A line holds at most 28 pulses.
+	char bits[SIM_DCF_BITS + 1];
+	char line[40];
+	expect_reply("dcf m\r", "bit 0 conf 0\r\n");
+	for ( unsigned mi = 0; mi < 2; mi++ )
+	{
+		sim_dcf_encode(bits, 2024, 3, 10, 10, mi, 0);
+		for ( unsigned b = 0; b < SIM_DCF_BITS; b += 20 )
+		{
+			char reply[32];
+			unsigned end = ( b + 20 < SIM_DCF_BITS ) ? b + 20 : SIM_DCF_BITS;
+			snprintf(line, sizeof(line), "dcf %.*s\r", (int)(end - b), bits + b);
+			snprintf(reply, sizeof(reply), "bit %u conf %u\r\n", end, mi);
+			expect_reply(line, reply);
+		}
+		snprintf(line, sizeof(line), "bit 0 conf %u\r\n", mi + 1);
+		expect_reply("dcf m\r", line);
+		CHECK(dcfSynced == mi, "after frame %u: dcfSynced %u", mi, dcfSynced);
+		sim_run(sim_now + SIM_S(60) - SIM_S(4));
+	}
+	sim_run(sim_now + SIM_S(10));
+	CHECK(strcmp(sim_display_text(), "1002") == 0, "after dcf: display \"%s\", expected \"1002\"", sim_display_text());
+	expect_reply("dcf 01x\r", "usage: dcf [01m]...\r\n");
+
+	CHECK(bad_frames == 0, "%u bad frames", bad_frames);
+	CHECK(sim_tx_stalls == 0, "%lu stalls", sim_tx_stalls);
+
+	return sim_report("test_console");
+}
@@ -0,0 +1,242 @@
+/* test_frame.cpp - DCF frame decoding: good frames, every single-bit error, setting the clock
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include <string.h>
+#include "dcfdecoder.h"
+#include "calendar.h"
+#include "timekeeper.h"
+#include "sim.h"
+#include "simdcf.h"
+
+// Frames are fed to the decoder with DcfInject(), as by the console's "dcf" command, so the
+// demodulator isn't involved. See bench_demod for that.
+
+typedef struct
+{
+	unsigned y, mo, d, h, mi;
+	int cest;
+} frametime_t;
+
+static const frametime_t frames[] =
+{	{	2024,	2,	29,	12,	34,	0	},
+	{	2000,	1,	1,	0,	0,	0	},
+	{	2099,	12,	31,	23,	59,	0	},
+	{	2025,	7,	14,	9,	7,	1	},
+	{	2023,	3,	26,	3,	0,	1	}
+};
+
+#define N_FRAMES	(sizeof(frames)/sizeof(frames[0]))
+
+static void inject(const char *bits)
+{
+	while ( *bits != '\0' )
+		DcfInject(*bits++);
+}
+
+// decode() - feed the bits, decode them, then start a new frame with a minute mark
+static unsigned char decode(const char *bits, datetime_t *dt)
+{
+	inject(bits);
+	unsigned char err = dcfDecodeFrame(dt);
+	DcfInject('m');
+	return err;
+}
+
+// expect_error() - the error that a flipped bit must cause (DcfErr_None: the bit isn't protected)
+static unsigned char expect_error(int bit)
+{
+	if ( bit == 0 || bit == 20 )
+		return DcfErr_Fixed;			// M, S
+	if ( bit >= 21 )
+		return DcfErr_Parity;			// Time and date fields and the parity bits
+	if ( bit == 17 || bit == 18 )
+		return DcfErr_Zone;
+	return DcfErr_None;					// Weather, call bit, A1, A2
+}
+
+static void check_time(const datetime_t *dt, const frametime_t *f, const char *what)
+{
+	unsigned char mo, d;
+	yday_to_date(dt->years, dt->days, &mo, &d);
+	CHECK(dt->years == f->y && mo == f->mo && d == f->d && dt->hours == f->h && dt->mins == f->mi,
+		"%s: decoded %u-%02u-%02u %02u:%02u, expected %u-%02u-%02u %02u:%02u", what,
+		dt->years, mo, d, dt->hours, dt->mins, f->y, f->mo, f->d, f->h, f->mi);
+}
+
+// Two frames a minute apart synchronise the clock, and the display shows the new time at once
+static void test_sync(void)
+{
+	char bits[SIM_DCF_BITS + 1];
+
+	sim_run(SIM_S(5));
+	DcfInject('m');
+
+	sim_dcf_encode(bits, 2024, 2, 29, 12, 34, 0);
+	inject(bits);
+	DcfInject('m');
+	CHECK(!dcfSynced, "synchronised after one frame");
+
+	sim_run(sim_now + SIM_S(60));
+	sim_dcf_encode(bits, 2024, 2, 29, 12, 35, 0);
+	inject(bits);
+	DcfInject('m');
+	CHECK(dcfSynced, "not synchronised after two frames");
+
+	sim_run(sim_now + SIM_MS(500));
+	CHECK(strcmp(sim_display_text(), "1235") == 0, "display \"%s\" after sync, expected \"1235\"", sim_display_text());
+}
+
+// wait_clock() - run until the clock reads t
+static void wait_clock(unsigned long t)
+{
+	while ( getepoch() < t )
+		sim_run(sim_now + SIM_MS(100));
+}
+
+// send() - when the clock reads at, send the frame for time t, with bits b1 and b2 (if >= 0) flipped.
+// Returns the epoch of the clock just after the minute mark.
+static unsigned long send(unsigned long at, unsigned long t, int cest, int b1, int b2, const char *what)
+{
+	char bits[SIM_DCF_BITS + 1];
+	datetime_t dt;
+	unsigned char secs, mo, d;
+
+	breaktime(t, &dt, &secs);
+	yday_to_date(dt.years, dt.days, &mo, &d);
+	sim_dcf_encode(bits, dt.years, mo, d, dt.hours, dt.mins, cest);
+	if ( b1 >= 0 )
+		bits[b1] ^= 1;
+	if ( b2 >= 0 )
+		bits[b2] ^= 1;
+
+	wait_clock(at);
+	inject(bits);
+	unsigned char err = dcfDecodeFrame(&dt);
+	CHECK(err == DcfErr_None, "%s: error %u", what, err);
+	DcfInject('m');
+	return getepoch();
+}
+
+// A synchronised clock is only moved by a frame that agrees with it, or by DcfAgreeFull frames in a row
+// that agree with each other. Runs on from test_sync().
+static void test_consensus(void)
+{
+	unsigned long t = (getepoch() / 60 + 1) * 60;
+	unsigned long clk;
+	char disp[8];
+
+	clk = send(t, t, 0, -1, -1, "good frame");
+	CHECK(clk == t && dcfConfidence == 3, "good frame: clock %+ld, confidence %u", (long)(clk - t), dcfConfidence);
+
+	// Errors that the checks don't catch: hours bits 1 and 2 flipped, and a date two weeks out
+	// (29 to 15: four date bits flipped, same day of the week)
+	t += 60;
+	clk = send(t + 3, t, 0, 29, 30, "wrong hour");
+	CHECK(clk == t + 3 && dcfConfidence == 1, "wrong hour: clock %+ld, confidence %u", (long)(clk - t), dcfConfidence);
+	t += 60;
+	clk = send(t + 3, t - 14 * 86400L, 0, -1, -1, "wrong date");
+	CHECK(clk == t + 3 && dcfConfidence == 1, "wrong date: clock %+ld, confidence %u", (long)(clk - t), dcfConfidence);
+	sim_run(sim_now + SIM_MS(500));
+	datetime_t dt;
+	unsigned char secs;
+	breaktime(t + 3, &dt, &secs);
+	snprintf(disp, sizeof(disp), "%2u%02u", dt.hours, dt.mins);
+	CHECK(strcmp(sim_display_text(), disp) == 0, "display \"%s\" after wrong frames, expected \"%s\"", sim_display_text(), disp);
+
+	// The next good frame is still accepted: it realigns the clock, which is now 2 s fast
+	t += 60;
+	clk = send(t + 2, t, 0, -1, -1, "good frame after wrong ones");
+	CHECK(clk == t, "good frame after wrong ones: clock %+ld", (long)(clk - t));
+
+	// A new time an hour ahead needs DcfAgreeFull frames
+	unsigned long n = t + 3600;
+	for ( unsigned i = 1; i <= 3; i++ )
+	{
+		t += 60;
+		n += 60;
+		clk = send(t, n, 0, -1, -1, "new time");
+		CHECK(dcfConfidence == i, "new time, frame %u: confidence %u", i, dcfConfidence);
+		CHECK(clk == ( i < 3 ? t : n ), "new time, frame %u: clock %+ld from the old time", i, (long)(clk - t));
+	}
+	t = n;
+
+	// A change of time zone starts a new chain
+	t += 60;
+	send(t, t, 0, -1, -1, "before zone change");
+	CHECK(dcfConfidence == 3, "before zone change: confidence %u", dcfConfidence);
+	t += 60;
+	send(t, t, 1, -1, -1, "zone change");
+	CHECK(dcfConfidence == 1, "zone change: confidence %u", dcfConfidence);
+	t += 60;
+	send(t, t, 1, -1, -1, "after zone change");
+	CHECK(dcfConfidence == 2, "after zone change: confidence %u", dcfConfidence);
+	CHECK(dcfSynced, "not synchronised");
+}
+
+static void test_frames(void)
+{
+	char bits[SIM_DCF_BITS + 2];
+	datetime_t dt;
+	unsigned n = 0;
+
+	for ( unsigned f = 0; f < N_FRAMES; f++ )
+	{
+		const frametime_t *ft = &frames[f];
+		sim_dcf_encode(bits, ft->y, ft->mo, ft->d, ft->h, ft->mi, ft->cest);
+
+		unsigned char err = decode(bits, &dt);
+		CHECK(err == DcfErr_None, "frame %u: error %u", f, err);
+		if ( err == DcfErr_None )
+			check_time(&dt, ft, "good frame");
+
+		for ( int b = 0; b < SIM_DCF_BITS; b++ )
+		{
+			bits[b] ^= 1;				// '0' <-> '1'
+			err = decode(bits, &dt);
+			bits[b] ^= 1;
+			n++;
+
+			unsigned char exp = expect_error(b);
+			CHECK(err == exp, "frame %u bit %d flipped: error %u, expected %u", f, b, err, exp);
+			if ( err == DcfErr_None && exp == DcfErr_None )
+				check_time(&dt, ft, "unprotected bit flipped");
+		}
+
+		bits[SIM_DCF_BITS - 1] = '\0';
+		err = decode(bits, &dt);
+		CHECK(err == DcfErr_Short, "frame %u, 58 bits: error %u", f, err);
+		sim_dcf_encode(bits, ft->y, ft->mo, ft->d, ft->h, ft->mi, ft->cest);
+		strcat(bits, "0");
+		err = decode(bits, &dt);
+		CHECK(err == DcfErr_Long, "frame %u, 60 bits: error %u", f, err);
+	}
+
+	printf("test_frame: %u frames, %u single-bit errors\n", (unsigned)N_FRAMES, n);
+}
+
+int main(void)
+{
+	test_sync();
+	test_consensus();
+	test_frames();
+	return sim_report("test_frame");
+}
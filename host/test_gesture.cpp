@@ -0,0 +1,204 @@
+/* test_gesture.cpp - scripted button timelines through the gesture recogniser
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "displaydriver.h"
+
+// Each step presses buttons at given offsets from "now", lets the clock run and checks the display
+// mode. A chord needs Mode to be held first; Up or Down followed by Mode is not a chord.
+
+#define PIN_UP		6
+#define PIN_DOWN	7
+#define PIN_MODE	8
+
+#define T_SETTLE	SIM_S(7)			// Longer than the 5 s timeout back to hh:mm
+
+// Timing of the gestures in button.cpp
+#define LONG_TIME	SIM_MS(1000)
+#define DOUBLE_TIME	SIM_MS(400)
+#define DEBOUNCE	SIM_MS(40)
+
+// Bound to Down in normal state in the host build (see button.cpp)
+extern unsigned btn_test_short, btn_test_long, btn_test_double;
+
+static void expect_mode(unsigned char mode, const char *what)
+{
+	CHECK(display_mode == mode, "%s: display_mode 0x%02x, expected 0x%02x", what, display_mode, mode);
+}
+
+// chord() - press first, then press second while first is held; release second, then first
+static void chord(unsigned char first, unsigned char second)
+{
+	simtime_t t = sim_now;
+
+	sim_press(first, t, SIM_MS(600));
+	sim_press(second, t + SIM_MS(200), SIM_MS(200));
+	sim_run(t + SIM_S(1));
+}
+
+// count_changes() - run until t and count how often the display text changes
+static unsigned count_changes(simtime_t t)
+{
+	char prev[8];
+	unsigned n = 0;
+
+	strcpy(prev, sim_display_text());
+	while ( sim_now < t )
+	{
+		sim_run(sim_now + SIM_MS(20));
+		if ( strcmp(prev, sim_display_text()) != 0 )
+		{
+			strcpy(prev, sim_display_text());
+			n++;
+		}
+	}
+	return n;
+}
+
+static void expect_counts(unsigned n_short, unsigned n_long, unsigned n_double, const char *what)
+{
+	CHECK(btn_test_short == n_short && btn_test_long == n_long && btn_test_double == n_double,
+		"%s: short %u long %u double %u, expected %u %u %u", what,
+		btn_test_short, btn_test_long, btn_test_double, n_short, n_long, n_double);
+	btn_test_short = btn_test_long = btn_test_double = 0;
+}
+
+// Long and double presses of Down in normal state
+static void test_long_double(void)
+{
+	simtime_t t;
+
+	btn_test_short = btn_test_long = btn_test_double = 0;
+
+	// A short press waits DOUBLE_TIME for a second press before it counts
+	t = sim_now;
+	sim_press(PIN_DOWN, t, SIM_MS(100));
+	sim_run(t + SIM_MS(100) + DEBOUNCE + DOUBLE_TIME - SIM_MS(100));
+	expect_counts(0, 0, 0, "short, waiting for a double");
+	sim_run(t + SIM_S(1));
+	expect_counts(1, 0, 0, "short");
+
+	// Second press within DOUBLE_TIME: a double press and no short one
+	t = sim_now;
+	sim_press(PIN_DOWN, t, SIM_MS(100));
+	sim_press(PIN_DOWN, t + SIM_MS(300), SIM_MS(100));
+	sim_run(t + SIM_S(2));
+	expect_counts(0, 0, 1, "double inside DOUBLE_TIME");
+
+	// ... and outside it: two short presses
+	t = sim_now;
+	sim_press(PIN_DOWN, t, SIM_MS(100));
+	sim_press(PIN_DOWN, t + SIM_MS(100) + DOUBLE_TIME + SIM_MS(100), SIM_MS(100));
+	sim_run(t + SIM_S(2));
+	expect_counts(2, 0, 0, "double outside DOUBLE_TIME");
+
+	// A long press fires once, at LONG_TIME, and the release isn't a short press
+	t = sim_now;
+	sim_press(PIN_DOWN, t, SIM_MS(2500));
+	sim_run(t + DEBOUNCE + LONG_TIME - SIM_MS(100));
+	expect_counts(0, 0, 0, "long, before LONG_TIME");
+	sim_run(t + DEBOUNCE + LONG_TIME + SIM_MS(100));
+	expect_counts(0, 1, 0, "long, at LONG_TIME");
+	sim_run(t + SIM_S(4));
+	expect_counts(0, 0, 0, "long, after release");
+
+	// Another button pressed while a double press is still possible: the short press counts at once
+	t = sim_now;
+	sim_press(PIN_DOWN, t, SIM_MS(100));
+	sim_press(PIN_UP, t + SIM_MS(200), SIM_MS(100));
+	sim_run(t + SIM_MS(200) + DEBOUNCE + SIM_MS(40));
+	expect_counts(1, 0, 0, "short, then Up");
+	sim_run(t + SIM_S(2));
+	expect_counts(0, 0, 0, "short, then Up, later");
+
+	sim_run(sim_now + T_SETTLE);
+	expect_mode(state_normal | mode_hhmm, "after long and double presses");
+}
+
+int main(void)
+{
+	sim_run(SIM_S(2));
+	expect_mode(state_normal | mode_hhmm, "startup");
+
+	// Short press of Mode: next mode, then back to hh:mm after the timeout
+	sim_press(PIN_MODE, sim_now, SIM_MS(100));
+	sim_run(sim_now + SIM_S(1));
+	expect_mode(state_normal | mode_mmss, "Mode");
+	sim_run(sim_now + T_SETTLE);
+	expect_mode(state_normal | mode_hhmm, "Mode, timeout");
+
+	// Nothing is bound to a long press of Mode, so it counts as a short one
+	sim_press(PIN_MODE, sim_now, SIM_MS(1500));
+	sim_run(sim_now + SIM_S(2));
+	expect_mode(state_normal | mode_mmss, "Mode long");
+	sim_run(sim_now + T_SETTLE);
+
+	// Mode + Up switches off and on again
+	chord(PIN_MODE, PIN_UP);
+	expect_mode(state_off | mode_xxx, "Mode+Up");
+	chord(PIN_MODE, PIN_UP);
+	expect_mode(state_normal | mode_hhmm, "Mode+Up again");
+
+	// Up then Mode isn't a chord: Mode on its own advances the mode
+	chord(PIN_UP, PIN_MODE);
+	expect_mode(state_normal | mode_mmss, "Up then Mode");
+	sim_run(sim_now + T_SETTLE);
+
+	// Down then Mode doesn't enter setting state either
+	chord(PIN_DOWN, PIN_MODE);
+	expect_mode(state_normal | mode_mmss, "Down then Mode");
+	sim_run(sim_now + T_SETTLE);
+
+	// Mode + Down enters setting state
+	chord(PIN_MODE, PIN_DOWN);
+	expect_mode(state_setting | mode_hhmm, "Mode+Down");
+
+	// Up steps the digit once on a short press and repeats while held
+	simtime_t t = sim_now;
+	sim_press(PIN_UP, t, SIM_MS(100));
+	unsigned n_short = count_changes(t + SIM_S(1));
+	t = sim_now;
+	sim_press(PIN_UP, t, SIM_MS(2000));
+	unsigned n_held = count_changes(t + SIM_MS(2100));
+	printf("test_gesture: Up short %u, held 2 s %u display changes\n", n_short, n_held);
+	CHECK(n_short == 1, "Up short press: %u changes", n_short);
+	CHECK(n_held >= 8, "Up held 2 s: %u changes", n_held);
+	expect_mode(state_setting | mode_hhmm, "Up in setting");
+
+	// Mode steps to the next digit, Mode + Down leaves setting state
+	sim_press(PIN_MODE, sim_now, SIM_MS(100));
+	sim_run(sim_now + SIM_S(1));
+	expect_mode(state_setting | mode_hhmm, "Mode in setting");
+	chord(PIN_MODE, PIN_DOWN);
+	expect_mode(state_normal | mode_hhmm, "Mode+Down again");
+
+	// Mode + Up from setting state returns to normal without setting the time
+	chord(PIN_MODE, PIN_DOWN);
+	expect_mode(state_setting | mode_hhmm, "Mode+Down, third");
+	chord(PIN_MODE, PIN_UP);
+	expect_mode(state_normal | mode_hhmm, "Mode+Up in setting");
+
+	test_long_double();
+
+	return sim_report("test_gesture");
+}
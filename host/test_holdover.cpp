@@ -0,0 +1,86 @@
+/* test_holdover.cpp - keeping time through a DCF outage, with and without the drift correction
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include "timekeeper.h"
+#include "dcfdecoder.h"
+#include "sim.h"
+#include "simdcf.h"
+
+// The time base runs 0.2 % fast (173 s a day).
+//
+// Uncorrected: DCF for 20 minutes, enough to set the clock but too short to measure the drift,
+// then an outage of 7 days.
+// Corrected: DCF for 12 hours, so the drift has been learned, then another outage of 7 days.
+//
+// The error is measured after 24 hours and after 7 days of each outage.
+
+#define TICK_ERROR	0.002
+#define T_START		SIM_S(3) + SIM_MS(370)
+#define MINUTE0		1710064800LL			// 2024-03-10 10:00:00
+#define UNIX_2000	946684800LL				// The clock's epoch (CAL_EPOCH_YEAR) in Unix time
+
+// clock_error() - seconds that the clock is ahead of the DCF time
+static long clock_error(void)
+{
+	long long now = MINUTE0 - UNIX_2000 + (long long)((sim_now - (T_START)) / 1000000);
+	return (long)((long long)getepoch() - now);
+}
+
+// outage() - lose the signal for 7 days; return the errors after 24 hours and 7 days
+static void outage(const char *what, long *e1, long *e7)
+{
+	sim_dcf_stop();
+	sim_run(sim_now + SIM_S(86400));
+	*e1 = clock_error();
+	sim_run(sim_now + SIM_S(6 * 86400));
+	*e7 = clock_error();
+	printf("%s\t%ld\t%ld\n", what, *e1, *e7);
+}
+
+int main(void)
+{
+	long e1, e7;
+
+	sim_tick_error = TICK_ERROR;
+	sim_dcf_start(T_START, MINUTE0, 20.0, 1);
+
+	printf("test_holdover: clock error (s) after an outage\n");
+	printf("drift\t24h\t7d\n");
+
+	sim_run(T_START + SIM_S(20 * 60));
+	CHECK(dcfSynced, "not synchronised after 20 minutes");
+	CHECK(clock_error() == 0, "clock %ld s out before the outage", clock_error());
+	outage("none", &e1, &e7);
+	CHECK(e1 > 100, "uncorrected: only %ld s after 24 hours", e1);
+
+	unsigned long writes = sim_eeprom_writes;
+	sim_dcf_resume();
+	sim_run(sim_now + SIM_S(12 * 3600));
+	CHECK(clock_error() == 0, "clock %ld s out after 12 hours of DCF", clock_error());
+	CHECK(sim_eeprom_writes - writes <= 12, "%lu EEPROM writes in 12 hours", sim_eeprom_writes - writes);
+
+	outage("learned", &e1, &e7);
+	CHECK(e1 >= -2 && e1 <= 2, "corrected: %ld s after 24 hours", e1);
+	CHECK(e7 >= -10 && e7 <= 10, "corrected: %ld s after 7 days", e7);
+
+	return sim_report("test_holdover");
+}
@@ -0,0 +1,107 @@
+/* test_pins.cpp - pin traffic of the display driver, the buttons and the DCF receiver
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include "sim.h"
+
+// The simulator records every write to an output pin made through FastPin<>. In an hour of hh:mm:
+// the LED latch is pulsed once a second for the colon, the digit latch once a minute, and nothing
+// else changes. The buttons and the DCF input are only ever read. Until the first edge arrives from
+// the receiver the decoder keeps driving PON low, which is a write but not a change.
+
+#define PIN_DCF			2
+#define PIN_DCF_PON		4
+#define PIN_UP			6
+#define PIN_DOWN		7
+#define PIN_MODE		8
+#define PIN_LATCH_LEDS	9
+#define PIN_LATCH_DIGITS	10
+#define PIN_SPI_MOSI	11
+#define PIN_SPI_CLK		13
+
+static void check_quiet(unsigned char pin, const char *what)
+{
+	CHECK(sim_pin_writes[pin] == 0, "%lu writes to %s (pin %u)", sim_pin_writes[pin], what, pin);
+}
+
+int main(void)
+{
+	// Startup: both latches pulsed to clear the display, receiver switched on after 1.1 s
+	sim_run(SIM_S(5));
+
+	simtime_t t_on = SIM_NEVER;
+	for ( unsigned i = 0; i < sim_ntrace; i++ )
+	{
+		unsigned char pin = sim_trace[i].pin;
+
+		CHECK(pin == PIN_DCF_PON || pin == PIN_LATCH_LEDS || pin == PIN_LATCH_DIGITS ||
+			pin == PIN_SPI_MOSI || pin == PIN_SPI_CLK, "write to pin %u at %.3f s", pin, sim_trace[i].t / 1e6);
+		if ( pin == PIN_DCF_PON && sim_trace[i].level == 0 && t_on == SIM_NEVER )
+			t_on = sim_trace[i].t;
+	}
+	CHECK(sim_pin_rises[PIN_DCF_PON] == 1, "DCF PON raised %lu times", sim_pin_rises[PIN_DCF_PON]);
+	CHECK(sim_pin_rises[PIN_LATCH_LEDS] >= 1 && sim_pin_rises[PIN_LATCH_DIGITS] >= 1, "display not latched at startup");
+	CHECK(sim_pin_level(PIN_DCF_PON) == 0, "DCF receiver not switched on");
+	CHECK(t_on >= SIM_MS(1000) && t_on <= SIM_MS(1300), "DCF receiver switched on at %.3f s", t_on / 1e6);
+	check_quiet(PIN_MODE, "Mode button");
+	check_quiet(PIN_UP, "Up button");
+	check_quiet(PIN_DOWN, "Down button");
+	check_quiet(PIN_DCF, "DCF input");
+
+	// An hour of hh:mm
+	sim_trace_clear();
+	unsigned long spi0 = sim_spi_bytes;
+	sim_run(sim_now + SIM_S(3600));
+	unsigned long spi = sim_spi_bytes - spi0;
+
+	printf("test_pins: in an hour\n");
+	printf("pin\twrites\trises\n");
+	for ( unsigned p = 0; p < SIM_NPINS; p++ )
+	{
+		if ( sim_pin_writes[p] != 0 )
+			printf("%u\t%lu\t%lu\n", p, sim_pin_writes[p], sim_pin_rises[p]);
+	}
+	printf("spi\t%lu\n", spi);
+
+	CHECK(sim_pin_rises[PIN_LATCH_LEDS] >= 3599 && sim_pin_rises[PIN_LATCH_LEDS] <= 3601,
+		"LED latch pulsed %lu times", sim_pin_rises[PIN_LATCH_LEDS]);
+	CHECK(sim_pin_rises[PIN_LATCH_DIGITS] >= 59 && sim_pin_rises[PIN_LATCH_DIGITS] <= 61,
+		"digit latch pulsed %lu times", sim_pin_rises[PIN_LATCH_DIGITS]);
+	CHECK(sim_pin_writes[PIN_LATCH_LEDS] == 2 * sim_pin_rises[PIN_LATCH_LEDS], "LED latch left high");
+	CHECK(sim_pin_writes[PIN_LATCH_DIGITS] == 2 * sim_pin_rises[PIN_LATCH_DIGITS], "digit latch left high");
+	CHECK(spi <= sim_pin_rises[PIN_LATCH_LEDS] + 5 * sim_pin_rises[PIN_LATCH_DIGITS],
+		"%lu bytes sent for %lu LED and %lu digit updates", spi, sim_pin_rises[PIN_LATCH_LEDS], sim_pin_rises[PIN_LATCH_DIGITS]);
+	CHECK(sim_pin_rises[PIN_DCF_PON] == 0 && sim_pin_level(PIN_DCF_PON) == 0, "DCF receiver switched off");
+	for ( unsigned p = 0; p < SIM_NPINS; p++ )
+	{
+		if ( p != PIN_DCF_PON && p != PIN_LATCH_LEDS && p != PIN_LATCH_DIGITS )
+			CHECK(sim_pin_writes[p] == 0, "%lu writes to pin %u", sim_pin_writes[p], p);
+	}
+
+	// A press of the Mode button is only read
+	sim_trace_clear();
+	sim_press(PIN_MODE, sim_now, SIM_MS(100));
+	sim_run(sim_now + SIM_S(1));
+	check_quiet(PIN_MODE, "Mode button");
+	CHECK(sim_pin_rises[PIN_LATCH_DIGITS] >= 1, "display not updated after Mode");
+
+	return sim_report("test_pins");
+}
@@ -0,0 +1,61 @@
+/* test_sleep.cpp - count the wakeups with and without sleeping between task deadlines
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include "sim.h"
+
+// The clock runs for an hour with IdleSleep() sleeping until the next deadline, then for a minute
+// polling like the tasker without an idle function (a poll every 10 us). A minute of polling is
+// enough to get the rate, and a simulated hour of it would take a while.
+
+#define BUSY_TIME	SIM_S(60)
+
+int main(void)
+{
+	sim_run(SIM_S(10));					// Startup: init timeout, display test
+
+	unsigned long w0 = sim_wakeups;
+	unsigned long i0 = sim_interrupts;
+	sim_run(sim_now + SIM_S(3600));
+	unsigned long sleep_wakeups = sim_wakeups - w0;
+	unsigned long sleep_interrupts = sim_interrupts - i0;
+
+	sim_busy = 1;
+	w0 = sim_wakeups;
+	i0 = sim_interrupts;
+	sim_run(sim_now + BUSY_TIME);
+	unsigned long busy_wakeups = (sim_wakeups - w0) * (SIM_S(3600) / BUSY_TIME);
+	unsigned long busy_interrupts = (sim_interrupts - i0) * (SIM_S(3600) / BUSY_TIME);
+
+	printf("test_sleep: per simulated hour\n");
+	printf("mode\twakeups\tinterrupts\n");
+	printf("sleep\t%lu\t%lu\n", sleep_wakeups, sleep_interrupts);
+	printf("busy\t%lu\t%lu\n", busy_wakeups, busy_interrupts);
+
+	// Sleeping, the CPU only wakes for the task deadlines: at most 10 per second (DcfDecoder, Console)
+	CHECK(sleep_wakeups <= 10 * 3600, "%lu wakeups per hour when sleeping", sleep_wakeups);
+	CHECK(sleep_wakeups * 1000 < busy_wakeups, "sleeping saves less than expected");
+
+	// The only regular interrupt is the timer 2 overflow (61 Hz); timer 0 would add 1000 Hz
+	CHECK(sleep_interrupts <= 100 * 3600, "%lu interrupts per hour when sleeping", sleep_interrupts);
+
+	return sim_report("test_sleep");
+}
@@ -0,0 +1,99 @@
+/* test_snapshot.cpp - time snapshots while a writer interrupts the reader at random
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <stdio.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "timekeeper.h"
+#include "sim.h"
+
+// A profiling timer signal plays the part of an interrupt: its handler sets the time, as the
+// DCF decoder does, while the main program reads it in a loop with getepoch() and gettime().
+// Every value read must be one that was written, and the time must never go backwards.
+//
+// A 32-bit load can't tear on the host, so this checks the protocol (no lost or invented
+// values, no hang when the writer interrupts the reader) rather than torn bytes.
+
+#define N_WRITES	500
+#define MAX_READS	4000000000UL
+#define SIGNAL_US	997				// The kernel rounds this up to its timer resolution
+
+static volatile unsigned long written;	// Latest time written
+static volatile unsigned long n_writes;
+static unsigned k;
+
+// writer() - step the time on by a minute and a bit, changing as many bytes as possible
+static void writer(int sig)
+{
+	datetime_t dt;
+
+	k++;
+	dt.years = 2024 + k / 100000;
+	dt.days = (k / 1440) % 365;
+	dt.hours = (k / 60) % 24;
+	dt.mins = k % 60;
+	if ( maketime(&dt) <= written )
+		return;							// Keep the sequence increasing
+
+	settime(&dt);
+	written = maketime(&dt);
+	n_writes++;
+}
+
+int main(void)
+{
+	sim_run(SIM_S(3));					// Initialise the modules
+	written = getepoch();
+
+	struct sigaction sa;
+	sa.sa_handler = writer;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGPROF, &sa, 0);
+
+	struct itimerval it;
+	it.it_interval.tv_sec = 0;
+	it.it_interval.tv_usec = SIGNAL_US;
+	it.it_value = it.it_interval;
+	setitimer(ITIMER_PROF, &it, 0);
+
+	unsigned long last = 0;
+	unsigned long bad = 0;
+	unsigned long n_reads = 0;
+	while ( n_writes < N_WRITES && n_reads < MAX_READS )
+	{
+		n_reads++;
+		unsigned long v = getepoch();
+		unsigned long w = written;		// Read after v, so v can't be newer
+		if ( v < last || v > w )
+			bad++;
+		last = v;
+	}
+
+	it.it_value.tv_usec = 0;
+	it.it_interval.tv_usec = 0;
+	setitimer(ITIMER_PROF, &it, 0);
+
+	printf("test_snapshot: %lu reads, %lu writes\n", n_reads, n_writes);
+	CHECK(bad == 0, "%lu inconsistent reads", bad);
+	CHECK(n_writes >= N_WRITES, "only %lu writes interrupted the reader", n_writes);
+	return sim_report("test_snapshot");
+}
@@ -133,6 +133,69 @@ void decrease_digit(void)
 	display_change |= change_digits;
 }
 
+// step_value() - add delta at the place of the current digit to the value that contains it
+// Unlike increase_digit() this carries into the next digit. The value wraps within its range:
+// hours 0..23, minutes 0..59, day 1..length of the month, month 1..12, year 0..9999.
+void step_value(int delta)
+{
+	unsigned char first, last;
+	int lo, hi;
+
+	switch ( display_mode )
+	{
+	case (state_setting | mode_hhmm):
+		first = d_index & 0x02;
+		last = first + 1;
+		lo = 0;
+		hi = ( first == 0 ) ? 23 : 59;
+		break;
+
+	case (state_setting | mode_DDMM):
+		first = d_index & 0x02;
+		last = first + 1;
+		lo = 1;
+		if ( first == 0 )
+		{
+			unsigned char M = d[2]*10 + d[3];
+			if ( M < 1 || M > 12 )
+				M = 1;
+			hi = monthlength(M - 1, dt.years);
+		}
+		else
+			hi = 12;
+		break;
+
+	default:
+		first = 0;
+		last = 3;
+		lo = 0;
+		hi = 9999;
+		break;
+	}
+
+	int place = 1;
+	for ( unsigned char i = d_index; i < last; i++ )
+		place *= 10;
+
+	int v = 0;
+	for ( unsigned char i = first; i <= last; i++ )
+		v = v * 10 + d[i];
+
+	int range = hi - lo + 1;
+	v = (v - lo + delta * place) % range;
+	if ( v < 0 )
+		v += range;
+	v += lo;
+
+	for ( unsigned char i = last + 1; i > first; i-- )
+	{
+		d[i-1] = v % 10;
+		v = v / 10;
+	}
+
+	display_digits();
+}
+
 void dps_off(void)
 {
 	setdigitdp(d_index, 0);
@@ -162,28 +225,8 @@ static void decode_time(void)
 
 static void decode_days(void)
 {
-	unsigned D = dt.days + 1;
-	unsigned char M = 0;
-
-	if ( D > monthdays[0] )
-	{
-		D -= monthdays[0];
-		M = 1;
-
-		unsigned feb = isleap(dt.years) ? 29 : 28;
-		if ( D > feb )
-		{
-			D -= feb;
-			M = 2;
-		}
-
-    	while ( M < 12 && D > monthdays[M] )
-    	{
-			D -= monthdays[M];
-			M++;
-		}
-	}
-	M += 1;
+	unsigned char D, M;
+	yday_to_date(dt.years, dt.days, &M, &D);
 
 	d[0] = D / 10;
 	d[1] = D % 10;
@@ -238,27 +281,13 @@ static void encode_days(void)
 		M = 1;
 	else if ( M > 12 )
 		M = 12;
-	M -= 1;
 
 	if ( D < 1 )
 		D = 1;
-	else if ( M == 1 )
-	{
-		// Special case for February
-		if ( isleap(dt.years) )
-		{
-			if ( D > 29 )
-				D = 29;
-		}
-		else if ( D > 28 )
-			D = 28;
-	}
-	else if ( D > monthdays[M] )
-		D = monthdays[M];
+	else if ( D > monthlength(M - 1, dt.years) )
+		D = monthlength(M - 1, dt.years);
 
-	dt.days = D - 1;
-	for ( int i = 0; i < M; i++ )
-		dt.days += monthdays[i];
+	dt.days = date_to_yday(dt.years, M, D);
 }
 
 static void encode_year(void)
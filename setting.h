@@ -27,6 +27,7 @@ extern void leave_setting(void);
 extern void advance_setting(void);
 extern void increase_digit(void);
 extern void decrease_digit(void);
+extern void step_value(int delta);
 extern void flash_dps(void);
 extern void dps_off(void);
 
@@ -21,30 +21,102 @@
 */
 #include "tasker.h"
 
+#if TASKER_STATS
+#include <Arduino.h>
+
+#define TASKER_TICKSPAN		256		// Measure the tick length over this many ticks (micros() wraps after 71 minutes)
+
+static void taskerClearStats(task_t *t)
+{
+	t->nRuns = 0;
+	t->nOverruns = 0;
+	t->tMin = 0xffff;
+	t->tMax = 0;
+	t->tSum = 0;
+	t->lateMax = 0;
+}
+#endif
+
+static volatile unsigned char taskerWake;	// A task has been notified; run a pass at once
+
 void taskerSetup(task_t taskList[], int nTasks)
 {
 	for ( int i = 0; i < nTasks; i++ )
 	{
 		taskList[i].initFunc(&taskList[i]);
+#if TASKER_STATS
+		taskerClearStats(&taskList[i]);
+#endif
 	}
 }
 
-void taskerRun(task_t taskList[], int nTasks, unsigned (*readtime)(void))
+/* taskerRun() - run the tasks for ever
+ *
+ * If idle is non-null it is called after each pass with the time (in readtime() units) of the
+ * earliest task deadline. The idle function can sleep until then; any interrupt that wakes it early
+ * simply causes another (empty) pass. With idle == 0 the tasker polls readtime() continuously.
+ *
+ * readtime() must be monotonic and 32 bits wide, so that elapsed is right even after a long pass.
+*/
+void taskerRun(task_t taskList[], int nTasks, unsigned long (*readtime)(void), taskidle_t idle)
 {
-	unsigned then = readtime();
+	unsigned long then = readtime();
+#if TASKER_STATS
+	unsigned long passUs = micros();	// Start of the pass
+	unsigned long tickUs = 0;			// Length of a readtime() tick, measured over TASKER_TICKSPAN ticks
+	unsigned long spanUs = passUs;
+	unsigned long spanStart = then;
+#endif
 
 	for (;;)
 	{
-		unsigned now = readtime();
-		unsigned elapsed = now - then;
+		unsigned long now = readtime();
+		unsigned long elapsed = now - then;
 
-		if ( elapsed > 0 )
+		if ( elapsed > 0 || taskerWake )
 		{
+			taskerWake = 0;
+#if TASKER_STATS
+			passUs = micros();
+			if ( now - spanStart >= TASKER_TICKSPAN )
+			{
+				tickUs = (passUs - spanUs) / (now - spanStart);
+				spanUs = passUs;
+				spanStart = now;
+			}
+#endif
 			for ( int i = 0; i < nTasks; i++ )
 			{
+				if ( taskList[i].notify )
+				{
+					taskList[i].notify = 0;
+					taskList[i].timer = elapsed;	// Due now (the timer counts from the previous pass)
+				}
+
 				if ( taskList[i].timer <= elapsed )
 				{
+#if TASKER_STATS
+					task_t *t = &taskList[i];
+					unsigned long start = micros();
+					unsigned long late = (elapsed - t->timer) * tickUs + (start - passUs);
+
+					t->runFunc(t, elapsed);
+
+					unsigned long x = micros() - start;
+					unsigned xt = ( x > 0xffff ) ? 0xffff : (unsigned)x;
+					t->nRuns++;
+					t->tSum += xt;
+					if ( xt < t->tMin )
+						t->tMin = xt;
+					if ( xt > t->tMax )
+						t->tMax = xt;
+					if ( late > 0xffff )
+						late = 0xffff;
+					if ( late > t->lateMax )
+						t->lateMax = (unsigned)late;
+#else
 					taskList[i].runFunc(&taskList[i], elapsed);
+#endif
 				}
 
 				if ( taskList[i].timer < elapsed )
@@ -53,6 +125,9 @@ void taskerRun(task_t taskList[], int nTasks, unsigned (*readtime)(void))
 					 * then executing the tasks takes longer than the interval.
 					*/
 					taskList[i].timer = 0;
+#if TASKER_STATS
+					taskList[i].nOverruns++;
+#endif
 				}
 				else
 				{
@@ -61,5 +136,72 @@ void taskerRun(task_t taskList[], int nTasks, unsigned (*readtime)(void))
 			}
 		}
 		then = now;
+
+		if ( idle != 0 )
+		{
+			unsigned next = taskList[0].timer;
+
+			for ( int i = 1; i < nTasks; i++ )
+			{
+				if ( taskList[i].timer < next )
+					next = taskList[i].timer;
+			}
+
+			if ( next > 0 )
+				idle(then + next);
+		}
 	}
 }
+
+/* taskerNotify() - make a task run as soon as possible
+ *
+ * The tasker runs another pass without waiting for readtime() to advance, and the task's timer is
+ * treated as expired, so the task runs within a pass of being notified. The task sets its next
+ * deadline as usual. Only single-byte flags are written, so this can be called from an ISR.
+*/
+void taskerNotify(task_t *t)
+{
+	t->notify = 1;
+	taskerWake = 1;
+}
+
+/* taskerWakePending() - return non-zero if a notification is waiting for the next pass
+ *
+ * The idle function must check this with interrupts disabled before it sleeps.
+*/
+unsigned char taskerWakePending(void)
+{
+	return taskerWake;
+}
+
+#if TASKER_STATS
+/* taskerPrintStats() - print the statistics of task i, then clear them
+ *
+ * Times are in microseconds. The lateness is measured from the deadline to the start of the task;
+ * whole ticks missed count as the measured length of a tick.
+*/
+void taskerPrintStats(Print &out, task_t taskList[], int i)
+{
+	task_t *t = &taskList[i];
+
+	out.print(F("task "));
+	out.print(i);
+	out.print(F(": runs "));
+	out.print(t->nRuns);
+	if ( t->nRuns > 0 )
+	{
+		out.print(F(" min "));
+		out.print(t->tMin);
+		out.print(F(" max "));
+		out.print(t->tMax);
+		out.print(F(" mean "));
+		out.print(t->tSum / t->nRuns);
+	}
+	out.print(F(" late "));
+	out.print(t->lateMax);
+	out.print(F(" overruns "));
+	out.println(t->nOverruns);
+
+	taskerClearStats(t);
+}
+#endif
@@ -24,17 +24,39 @@
 #ifndef TASKER_H
 #define TASKER_H	1
 
+// Per-task execution statistics. Off by default: they need micros(), so timer 0 has to keep running
+// and its overflow interrupt wakes the CPU 1000 times a second.
+#ifndef TASKER_STATS
+#define TASKER_STATS	0
+#endif
+
 typedef struct task_s task_t;
 typedef void (*taskinit_t)(task_t *);
 typedef void (*taskrun_t)(task_t *, unsigned long);
+typedef void (*taskidle_t)(unsigned long wakeTime);
 struct task_s
 {
 	taskinit_t initFunc;
 	taskrun_t runFunc;
 	unsigned timer;
+	volatile unsigned char notify;	// Set by taskerNotify(): run at the next pass
+#if TASKER_STATS
+	unsigned nRuns;				// No. of times the task has run
+	unsigned nOverruns;			// No. of times the next deadline had already passed after running
+	unsigned tMin;				// Shortest execution time (us)
+	unsigned tMax;				// Longest execution time (us)
+	unsigned long tSum;			// Sum of execution times (us), for the mean
+	unsigned lateMax;			// Largest release lateness (us after the deadline)
+#endif
 };
 
 void taskerSetup(task_t taskList[], int nTasks);
-void taskerRun(task_t taskList[], int nTasks, unsigned (*readtime)(void));
+void taskerRun(task_t taskList[], int nTasks, unsigned long (*readtime)(void), taskidle_t idle);
+void taskerNotify(task_t *t);
+unsigned char taskerWakePending(void);
+#if TASKER_STATS
+class Print;
+void taskerPrintStats(Print &out, task_t taskList[], int i);
+#endif
 
 #endif
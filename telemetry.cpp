@@ -0,0 +1,157 @@
+/* telemetry.cpp - non-blocking binary debug output
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <Arduino.h>
+#include "dcfclock.h"
+#include "tasker.h"
+#include "telemetry.h"
+
+#define TLM_MASK		(TLM_BUFLEN-1)
+#define TLM_INTERVAL	Ticks(20)		// Poll the UART this often while there's something to send
+#define TLM_IDLE		Ticks(60000)	// Fallback when the buffer is empty
+
+// Transmit ring. Only tasks write to it and only the telemetry task reads it, so no lock is needed.
+static unsigned char tlmBuf[TLM_BUFLEN];
+static unsigned char tlmHead;
+static unsigned char tlmTail;
+static unsigned tlmDropped;				// Records dropped since the last TLM_DROPPED record
+
+static task_t *tlmtask;
+
+TlmText tlmText;
+
+static unsigned char tlm_put(unsigned char id, const unsigned char *data, unsigned char len);
+
+void TelemetryInit(task_t *telemetryTask)
+{
+	tlmtask = telemetryTask;			// Remember this for use in tlm_record()
+	telemetryTask->timer = TLM_IDLE;
+	tlmHead = 0;
+	tlmTail = 0;
+	tlmDropped = 0;
+}
+
+// Telemetry() - copy as much as the UART will take without waiting
+void Telemetry(task_t *telemetryTask, unsigned long elapsed)
+{
+	int room = Serial.availableForWrite();
+
+	while ( tlmTail != tlmHead && room > 0 )
+	{
+		Serial.write(tlmBuf[tlmTail]);
+		tlmTail = (tlmTail + 1) & TLM_MASK;
+		room--;
+	}
+
+	telemetryTask->timer += ( tlmTail != tlmHead ) ? TLM_INTERVAL : TLM_IDLE;
+}
+
+// tlm_record() - queue a record for sending. Never waits: if there's no room the record is dropped.
+void tlm_record(unsigned char id, const void *data, unsigned char len)
+{
+	if ( len > TLM_MAX_PAYLOAD )
+		len = TLM_MAX_PAYLOAD;
+
+	if ( tlmDropped != 0 )
+	{
+		unsigned char d[2] = { (unsigned char)tlmDropped, (unsigned char)(tlmDropped >> 8) };
+		if ( tlm_put(TLM_DROPPED, d, 2) )
+			tlmDropped = 0;
+	}
+
+	if ( tlmDropped != 0 || !tlm_put(id, (const unsigned char *)data, len) )
+	{
+		if ( tlmDropped < 0xffff )
+			tlmDropped++;
+	}
+
+	if ( tlmtask != 0 )					// Records from other modules' init functions wait in the ring
+		taskerNotify(tlmtask);
+}
+
+// tlm_room() - return the number of bytes that can still be queued
+unsigned char tlm_room(void)
+{
+	return TLM_BUFLEN - 1 - ((tlmHead - tlmTail) & TLM_MASK);
+}
+
+// TlmText::write() - add a character to the current text record
+size_t TlmText::write(uint8_t c)
+{
+	buf[len++] = c;
+	if ( len >= TLM_MAX_PAYLOAD || c == '\n' )
+		flush();
+	return 1;
+}
+
+// TlmText::flush() - send the text collected so far
+void TlmText::flush(void)
+{
+	if ( len != 0 )
+	{
+		tlm_record(TLM_TEXT, buf, len);
+		len = 0;
+	}
+}
+
+// tlm_put() - COBS-encode a record into the ring. Returns 0 if there isn't room.
+// A record is shorter than 254 bytes, so there's only one block: the code byte is the distance
+// to the next zero, and every zero in the record is replaced by the distance to the one after it.
+static unsigned char tlm_put(unsigned char id, const unsigned char *data, unsigned char len)
+{
+	unsigned char rec[3 + TLM_MAX_PAYLOAD];
+	unsigned char n = 0;
+	unsigned t = (unsigned)ReadTime();
+
+	rec[n++] = id;
+	rec[n++] = (unsigned char)t;
+	rec[n++] = (unsigned char)(t >> 8);
+	for ( unsigned char i = 0; i < len; i++ )
+		rec[n++] = data[i];
+
+	unsigned char used = (tlmHead - tlmTail) & TLM_MASK;
+	if ( n + 2 > TLM_BUFLEN - 1 - used )
+		return 0;
+
+	unsigned char code_pos = tlmHead;
+	unsigned char code = 1;
+	unsigned char h = (tlmHead + 1) & TLM_MASK;
+
+	for ( unsigned char i = 0; i < n; i++ )
+	{
+		if ( rec[i] == 0 )
+		{
+			tlmBuf[code_pos] = code;
+			code_pos = h;
+			code = 1;
+		}
+		else
+		{
+			tlmBuf[h] = rec[i];
+			code++;
+		}
+		h = (h + 1) & TLM_MASK;
+	}
+	tlmBuf[code_pos] = code;
+	tlmBuf[h] = 0;						// Frame delimiter
+	tlmHead = (h + 1) & TLM_MASK;
+	return 1;
+}
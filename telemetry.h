@@ -0,0 +1,89 @@
+/* telemetry.h - non-blocking binary debug output
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#ifndef TELEMETRY_H
+#define TELEMETRY_H	1
+
+#include <Print.h>
+#include "tasker.h"
+
+/* Each record is: id, time (low 16 bits of ReadTime(), little-endian), payload.
+ * Records are COBS-encoded and terminated by a zero byte. tools/tlmdecode.py turns them back into text.
+ * If there's no room in the buffer the record is dropped and counted; the count is sent as a
+ * TLM_DROPPED record as soon as there's room again.
+ *
+ * Text (the startup banner, console replies) is sent as TLM_TEXT records through tlmText, so it
+ * never breaks into a record that's partly sent.
+*/
+#define TLM_DROPPED		0x01	// u16 no. of records dropped
+#define TLM_TEXT		0x02	// Up to TLM_MAX_PAYLOAD characters. A line ends with a record that ends in '\n'.
+#define TLM_BUTTON		0x10	// u8 debounced buttons (bit 0 mode, bit 1 up, bit 2 down)
+#define TLM_UI			0x11	// u8 TlmUi_xxx
+#define TLM_DCF_FRAME	0x20	// u8 DcfErr_xxx, u8 dcfConfidence, u8 edges lost from the full queue (total, wraps)
+
+// TLM_UI codes
+#define TlmUi_ModeNext			0
+#define TlmUi_EnterSetting		1
+#define TlmUi_LeaveSetting		2
+#define TlmUi_SwitchOff			3
+#define TlmUi_SwitchNormal		4
+#define TlmUi_RevertOff			5
+#define TlmUi_RevertNormal		6
+
+#define TLM_MAX_PAYLOAD	16
+#define TLM_BUFLEN		128				// Size of the transmit ring. Must be a power of 2
+
+/* Tasker init- and run functions
+*/
+void TelemetryInit(task_t *);
+void Telemetry(task_t *, unsigned long elapsed);
+
+extern void tlm_record(unsigned char id, const void *data, unsigned char len);
+extern unsigned char tlm_room(void);
+
+// TLM_TEXT_ROOM() - room in the ring needed to send n characters of text
+#define TLM_TEXT_ROOM(n)	((n) + 5 * (((n) + TLM_MAX_PAYLOAD - 1) / TLM_MAX_PAYLOAD))
+
+// TlmText - print text into the ring as TLM_TEXT records. A record is sent when it's full, at the
+// end of each line, or on flush().
+class TlmText : public Print
+{
+public:
+	size_t write(uint8_t c);
+	void flush(void);
+	using Print::write;
+private:
+	unsigned char buf[TLM_MAX_PAYLOAD];
+	unsigned char len;
+};
+
+extern TlmText tlmText;
+
+static inline void tlm_byte(unsigned char id, unsigned char v)
+{
+	tlm_record(id, &v, 1);
+}
+
+// TLM_LOG() - send a one-byte record if the module's level (LOG_xxx in dcfclock.h) includes it
+#define TLM_LOG(modlevel, level, id, v) \
+	do { if ( (modlevel) >= (level) ) tlm_byte((id), (v)); } while (0)
+
+#endif
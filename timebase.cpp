@@ -0,0 +1,126 @@
+/* timebase.cpp - time base for the tasker
+ *
+ * Part of dcfclock
+ *
+ * (c) David Haworth
+ *
+ * dcfclock is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * dcfclock is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with dcfclock.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * dcfclock is an Arduino sketch, written for an Arduino Nano
+*/
+#include <Arduino.h>
+#include <avr/sleep.h>
+#include "dcfclock.h"
+#include "tasker.h"
+
+// The hardware time base: ReadTime() and IdleSleep() for the tasker.
+// The host build ("make host") replaces this file with host/simtimebase.cpp, whose IdleSleep()
+// jumps the simulated time to the next deadline. The other modules' registers, pins and serial
+// port are provided by the simulator in host/sim.cpp.
+
+// TCNT1 modes
+#define FREQ_TCCR1B_EXT_RISING	0x07
+#define FREQ_TCCR1B_EXT_FALLING	0x06
+
+// TimebaseInit() - start timer 1 counting the time source
+void TimebaseInit(void)
+{
+	// Clear all the settings of timer 1
+	TCCR1A = 0;
+	TCCR1B = 0;
+
+	// Select external input as frequency source.
+    // 7 for rising edge, 6 for falling edge.
+    // All waveform generation functions are disabled (also in TCCR1A).
+    TCCR1B = FREQ_TCCR1B_EXT_RISING;
+
+    // Clear the counter
+    TCNT1 = 0;
+
+#if TimeSource != Time_millis
+	// The overflow interrupt extends timer 1 to 32 bits for ReadTime()
+	TIFR1 = _BV(TOV1);
+	TIMSK1 = _BV(TOIE1);
+#endif
+
+#if SleepWhenIdle
+	set_sleep_mode(SLEEP_MODE_IDLE);
+#if TimeSource != Time_millis
+	// Compare-match A wakes the CPU at the next task deadline.
+	// millis() isn't used in this mode, so stop timer 0 from waking the CPU every millisecond.
+	// The task statistics need micros(), so timer 0 keeps running when they're enabled.
+#if !TASKER_STATS
+	TIMSK0 &= ~_BV(TOIE0);
+#endif
+	TIMSK1 |= _BV(OCIE1A);
+#endif
+#endif
+}
+
+#if TimeSource != Time_millis
+static volatile unsigned timeHigh;		// Upper 16 bits of ReadTime()
+
+// Timer 1 overflow: extend the time base to 32 bits
+ISR(TIMER1_OVF_vect)
+{
+	timeHigh++;
+}
+#endif
+
+// Time function for the tasker module and for timestamps: 32 bits, monotonic.
+// In 50 Hz mode it wraps after about 2.7 years.
+unsigned long ReadTime(void)
+{
+#if TimeSource == Time_millis
+	return millis();
+#else
+	// The 16-bit read goes through the shared TEMP register, and the two halves must match,
+	// so an interrupt must not get in between
+	unsigned char sreg = SREG;
+	cli();
+	unsigned lo = TCNT1;
+	unsigned hi = timeHigh;
+	if ( (TIFR1 & _BV(TOV1)) != 0 && lo < 0x8000 )
+		hi++;							// Timer has overflowed but the interrupt hasn't run yet
+	SREG = sreg;
+	return ((unsigned long)hi << 16) | lo;
+#endif
+}
+
+#if SleepWhenIdle
+#if TimeSource != Time_millis
+// Timer 1 compare-match A only has to wake the CPU
+EMPTY_INTERRUPT(TIMER1_COMPA_vect);
+#endif
+
+// Idle function for the tasker module: sleep until wakeTime or until an interrupt occurs.
+// In millis mode the timer 0 interrupt wakes the CPU every millisecond anyway, so nothing is armed.
+void IdleSleep(unsigned long wakeTime)
+{
+#if TimeSource != Time_millis
+	OCR1A = (unsigned)wakeTime;			// A deadline more than 65535 ticks away just wakes early
+	TIFR1 = _BV(OCF1A);					// Discard any stale match
+#endif
+
+	cli();
+	if ( !taskerWakePending() && (long)(wakeTime - ReadTime()) > 0 )
+	{
+		sleep_enable();
+		sei();							// The instruction after sei() is executed before any interrupt
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+}
+#endif
@@ -19,104 +19,190 @@
  *
  * dcfclock is an Arduino sketch, written for an Arduino Nano
 */
+#include <avr/eeprom.h>
 #include "dcfclock.h"
 #include "timekeeper.h"
 #include "displaydriver.h"
+#include "dcfdecoder.h"
 
 #define TICKS_PER_SECOND	Ticks(1000)
 
-// Current date and time in local time. Initialise to 2020-10-12
-unsigned years = 2020;		// Year number
-unsigned days = 285;		// No. of days since 01.01 (0..364) (0..365 in leap year)
-char leapday;				// 1 if current year is a leap year
+// Phase lock to the DCF second marks. The length of each second is adjusted in steps of 1/256 tick.
+#define PLL_GAIN			8		// Correct 1/8 of the phase error each second
+#define PLL_MAX_SLEW		128		// At most half a tick per second, so the seconds never jump
+#define PLL_LOCKED			50		// Phase error (ms) below which the loop is considered locked
 
-unsigned char hours;		// No. of hours  0..23
-unsigned char mins;			// No. of minutes 0..59
-unsigned char secs;			// No of seconds 0..59
+// Learned frequency error of the time base, in 1/65536 tick per second.
+// It is measured from the PLL slew between two DCF references when the loop is locked at both ends.
+#define DRIFT_MIN_SECONDS	1800	// Shortest measurement
+#define DRIFT_MAX_SECONDS	14400	// Longest measurement; start again after this
+#define DRIFT_GAIN			2		// Take half of each measurement
+#define DRIFT_LIMIT			((long)TICKS_PER_SECOND * 65536 / 100)	// 1 %
+#define DRIFT_SAVE_SECONDS	3600	// Save to EEPROM at most once an hour
+#define DRIFT_TAG			(0xd0 | TimeSource)	// The estimate is only valid for the same time source
 
-//								J	F	M	A	M	J	J	A	S	O	N	D
-unsigned char monthdays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+// The time is kept as a count of seconds since EPOCH_YEAR-01-01 00:00:00 (local time).
+// 32 bits are enough for 136 years.
+#define EPOCH_YEAR			CAL_EPOCH_YEAR
+#define LAST_YEAR			(EPOCH_YEAR + 135)
+#define SECS_PER_DAY		86400UL
+
+static unsigned long now_secs;		// Only the timekeeper uses this directly
+
+// The published time is guarded by a sequence counter: the writer makes it odd while it
+// changes the fields, so a reader that sees an odd or changed count tries again.
+// A reader must not interrupt the writer (it would wait for ever); a writer may interrupt a reader.
+static volatile unsigned char time_seq;
+static volatile timesnap_t time_pub;
+
+// Calendar fields for the time cal_secs. Worked out from now_secs only when needed.
+static unsigned long cal_secs;
+static unsigned cal_dayno = 0xffff;	// Day number (since the epoch) of cal.years and cal.days
+static datetime_t cal;
+static unsigned char cal_sec;
 
 unsigned char update_time;
 
+static int slew;			// Correction to the length of a second (1/256 tick)
+static long frac;			// Fractional ticks not yet applied (1/65536 tick)
+static unsigned char since_mark = 255;	// Seconds since the last DCF second mark
+static int last_offset;		// Latest DCF phase error (ms)
+
+static long drift;			// Frequency correction (1/65536 tick per second)
+static long slew_sum;		// Sum of the slew since the start of the measurement (1/256 tick)
+static unsigned drift_secs;	// Length of the measurement so far
+static unsigned save_secs;	// Time since the estimate was last saved
+
+typedef struct
+{
+	unsigned char tag;
+	long drift;
+} drift_ee_t;
+
+static drift_ee_t EEMEM drift_ee;
+
 task_t *tktask;
 
+// publish_time() - make now_secs visible to timesnapshot()
+static void publish_time(void)
+{
+	time_seq++;
+	time_pub.secs = now_secs;
+	time_seq++;
+}
+
 void TimekeeperInit(task_t *timekeeperTask)
 {
 	tktask = timekeeperTask;		// Remember this for use in settime()
 
 	timekeeperTask->timer = TICKS_PER_SECOND;
 
-	leapday = isleap(years);
-	if ( leapday )
-		monthdays[1] = 29;
+	// Initialise to 2020-10-12
+	datetime_t dt;
+	dt.years = 2020;
+	dt.days = 285;
+	dt.hours = 0;
+	dt.mins = 0;
+	now_secs = maketime(&dt);
+	publish_time();
+
+	drift_ee_t ee;
+	eeprom_read_block(&ee, &drift_ee, sizeof(ee));
+	if ( ee.tag == DRIFT_TAG && ee.drift >= -DRIFT_LIMIT && ee.drift <= DRIFT_LIMIT )
+		drift = ee.drift;
 }
 
 void Timekeeper(task_t *timekeeperTask, unsigned long elapsed)
 {
-	timekeeperTask->timer += TICKS_PER_SECOND;
+	unsigned period = TICKS_PER_SECOND;
 
-	unsigned char dmode = display_mode & 0x0f;
+	// Without DCF second marks, run freely (but with the drift correction).
+	if ( since_mark > 0 )
+		slew = 0;
+	if ( since_mark < 255 )
+		since_mark++;
+
+	frac += drift + (long)slew * 256;
+	while ( frac >= 65536 )
+	{
+		period++;
+		frac -= 65536;
+	}
+	while ( frac <= -65536 )
+	{
+		period--;
+		frac += 65536;
+	}
+	timekeeperTask->timer += period;
 
-	secs++;
-	if ( secs >= 60 )
+	slew_sum += slew;
+	drift_secs++;
+	if ( drift_secs > DRIFT_MAX_SECONDS )
 	{
-		secs = 0;
-		mins++;
-		if ( mins >= 60 )
-		{
-			mins = 0;
-			hours++;
-			if ( hours >= 24 )
-			{
-				hours = 0;
-				days++;
-
-				if ( days >= (365 + leapday) )
-				{
-					days = 0;
-					years++;
-					leapday = isleap(years);
-					if ( leapday )
-						monthdays[1] = 29;
-					else
-						monthdays[1] = 28;
-
-					if ( dmode == mode_YYYY )
-					{
-						update_time = 1;
-					}
-				}
-
-				if ( dmode == mode_DDMM )
-				{
-					update_time = 1;
-				}
-			}
-		}
-
-		// If mode is hh:mm, update the display when the minutes change
-		if ( dmode == mode_hhmm )
-		{
-			update_time = 1;
-		}
+		slew_sum = 0;
+		drift_secs = 0;
 	}
+	if ( save_secs < DRIFT_SAVE_SECONDS )
+		save_secs++;
+
+	DcfSecondTick();
+
+	unsigned char dmode = display_mode & 0x0f;
+
+	now_secs++;
+	publish_time();
+
+	unsigned long sod = now_secs % SECS_PER_DAY;
 
 	// If mode is mm:ss, update the display when the seconds change.
+	// If mode is hh:mm, update the display when the minutes change
+	// In the date modes, update the display when the day changes.
 	if ( dmode == mode_mmss )
-	{
 		update_time = 1;
+	else if ( dmode == mode_hhmm && (sod % 60) == 0 )
+		update_time = 1;
+	else if ( (dmode == mode_DDMM || dmode == mode_YYYY) && sod == 0 )
+		update_time = 1;
+
+	display_notify();					// Colon and digits change on the second tick
+}
+
+// calendar() - bring the calendar fields up to date with now_secs
+static void calendar(void)
+{
+	unsigned long t = getepoch();
+
+	if ( cal_secs == t && cal_dayno != 0xffff )
+		return;
+
+	unsigned dayno = t / SECS_PER_DAY;
+	unsigned long sod = t % SECS_PER_DAY;
+
+	if ( dayno != cal_dayno )
+	{
+		unsigned char s;
+		breaktime(t - sod, &cal, &s);
+		cal_dayno = dayno;
 	}
+
+	cal.hours = sod / 3600;
+	sod = sod % 3600;
+	cal.mins = sod / 60;
+	cal_sec = sod % 60;
+	cal_secs = t;
 }
 
 void flash_colon()
 {
-	setcolon(secs & 0x01);				// Flashing colon for time display
+	setcolon(getepoch() & 0x01);			// Flashing colon for time display
 	display_change |= change_leds;
 }
 
 void set_mmss(void)
 {
+	calendar();
+	unsigned char secs = cal_sec;
+	unsigned char mins = cal.mins;
 	setdigitnumeric(3, secs % 10);
 	setdigitnumeric(2, secs / 10);
 	setdigitnumeric(1, mins % 10);
@@ -126,6 +212,9 @@ void set_mmss(void)
 
 void set_hhmm(void)
 {
+	calendar();
+	unsigned char mins = cal.mins;
+	unsigned char hours = cal.hours;
 	setdigitnumeric(3, mins % 10);
 	setdigitnumeric(2, mins / 10);
 	setdigitnumeric(1, hours % 10);
@@ -138,16 +227,9 @@ void set_hhmm(void)
 
 void set_DDMM(void)
 {
-	unsigned d = days + 1;
-	unsigned char m = 0;
-	unsigned char md;
-
-	while ( m < 12 && d > monthdays[m] )
-	{
-		d -= monthdays[m];
-		m++;
-	}
-	m += 1;
+	calendar();
+	unsigned char d, m;
+	yday_to_date(cal.years, cal.days, &m, &d);
 
 	setdigitnumeric(3, m % 10);
 	setdigitnumeric(2, m / 10);
@@ -159,7 +241,8 @@ void set_DDMM(void)
 
 void set_YYYY(void)
 {
-	unsigned y = years;
+	calendar();
+	unsigned y = cal.years;
 	setdigitnumeric(3, y % 10);
 	y = y / 10;
 	setdigitnumeric(2, y % 10);
@@ -173,42 +256,123 @@ void set_YYYY(void)
 
 unsigned char getsecs(void)
 {
-	return secs;
+	return getepoch() % 60;
+}
+
+// getepoch() - return the time in seconds since the epoch
+unsigned long getepoch(void)
+{
+	timesnap_t ts;
+	timesnapshot(&ts);
+	return ts.secs;
+}
+
+// timesnapshot() - get a consistent copy of the time without an interrupt lock
+void timesnapshot(timesnap_t *ts)
+{
+	unsigned char seq;
+
+	do
+	{
+		seq = time_seq;
+		ts->secs = time_pub.secs;
+	} while ( (seq & 0x01) != 0 || seq != time_seq );
 }
 
 void gettime(datetime_t *dt)
 {
-	dt->years = years;
-	dt->days = days;
-	dt->hours = hours;
-	dt->mins = mins;
+	calendar();
+	*dt = cal;
 }
 
 void settime(const datetime_t *dt)
 {
-	years = dt->years;
-	days = dt->days;
-	hours = dt->hours;
-	mins = dt->mins;
-	secs = 0;
-	leapday = isleap(years);
+	now_secs = maketime(dt);
+	publish_time();
 
 	// First second tick occurs one second from now (off by up to 1 tick of ReadTime()).
 	tktask->timer = TICKS_PER_SECOND;
+	slew = 0;
+	frac = 0;
+	slew_sum = 0;				// A step invalidates the drift measurement
+	drift_secs = 0;
+	DcfSecondTick();
+}
+
+// second_mark() - a DCF second mark was seen offset ms after the second tick (negative: before).
+// Adjust the length of the coming seconds to reduce the offset gradually.
+void second_mark(int offset)
+{
+	long e = (long)offset * 256 * TICKS_PER_SECOND / 1000 / PLL_GAIN;
+
+	if ( e > PLL_MAX_SLEW )
+		e = PLL_MAX_SLEW;
+	else if ( e < -PLL_MAX_SLEW )
+		e = -PLL_MAX_SLEW;
 
+	slew = (int)e;
+	since_mark = 0;
+	last_offset = offset;
 }
 
-char isleap(unsigned y)
+// drift_reference() - DCF confirms the time. If the phase lock is good and the measurement is long
+// enough, update the estimate of the time base's frequency error.
+void drift_reference(void)
 {
-	if ( (y % 4) == 0 )
+	if ( since_mark > 2 || last_offset > PLL_LOCKED || last_offset < -PLL_LOCKED )
+		return;
+
+	if ( drift_secs < DRIFT_MIN_SECONDS )
+		return;
+
+	// Average slew over the measurement is the frequency error that remains
+	long residual = slew_sum * 256 / (long)drift_secs;
+
+	drift += residual / DRIFT_GAIN;
+	if ( drift > DRIFT_LIMIT )
+		drift = DRIFT_LIMIT;
+	else if ( drift < -DRIFT_LIMIT )
+		drift = -DRIFT_LIMIT;
+
+	slew_sum = 0;
+	drift_secs = 0;
+
+	if ( save_secs >= DRIFT_SAVE_SECONDS )
 	{
-		if ( (y % 100) == 0 )
-		{
-			if ( (y % 400) == 0 )
-				return 1;
-			return 0;
-		}
-		return 1;
+		drift_ee_t ee;
+		ee.tag = DRIFT_TAG;
+		ee.drift = drift;
+		eeprom_update_block(&ee, &drift_ee, sizeof(ee));
+		save_secs = 0;
 	}
-	return 0;
+}
+
+// maketime() - convert a date and time to seconds since the epoch
+// Years outside the range of the epoch are limited to the first or last representable year.
+unsigned long maketime(const datetime_t *dt)
+{
+	unsigned y = dt->years;
+	if ( y < EPOCH_YEAR )
+		y = EPOCH_YEAR;
+	else if ( y > LAST_YEAR )
+		y = LAST_YEAR;
+
+	unsigned d = dt->days;
+	if ( d > 364u + isleap(y) )
+		d = 364 + isleap(y);
+
+	unsigned long dayno = days_since_epoch(y) + d;
+
+	return (dayno * 24 + dt->hours) * 3600 + dt->mins * 60UL;
+}
+
+// breaktime() - convert seconds since the epoch to a date and time
+void breaktime(unsigned long t, datetime_t *dt, unsigned char *s)
+{
+	unsigned long sod = t % SECS_PER_DAY;
+	epoch_days_to_year(t / SECS_PER_DAY, &dt->years, &dt->days);
+	dt->hours = sod / 3600;
+	sod = sod % 3600;
+	dt->mins = sod / 60;
+	*s = sod % 60;
 }
@@ -23,6 +23,7 @@
 #define TIMEKEEPER_H	1
 
 #include "tasker.h"
+#include "calendar.h"
 
 // Structure parameter for gettime() and settime()
 typedef struct
@@ -33,7 +34,11 @@ typedef struct
 	unsigned char mins;		// No. of minutes 0..59
 } datetime_t;
 
-extern unsigned char monthdays[12];
+// Consistent copy of the time for timesnapshot()
+typedef struct
+{
+	unsigned long secs;		// Seconds since the epoch
+} timesnap_t;
 
 /* Tasker init- and run functions
 */
@@ -50,7 +55,11 @@ extern void set_YYYY(void);
 extern void gettime(datetime_t *dt);
 extern void settime(const datetime_t *dt);
 extern unsigned char getsecs(void);
-
-extern char isleap(unsigned years);
+extern unsigned long getepoch(void);
+extern void timesnapshot(timesnap_t *ts);
+extern unsigned long maketime(const datetime_t *dt);
+extern void breaktime(unsigned long t, datetime_t *dt, unsigned char *secs);
+extern void second_mark(int offset);
+extern void drift_reference(void);
 
 #endif
@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+# tlmdecode.py - turn dcfclock telemetry (see telemetry.h) back into text
+#
+# Part of dcfclock
+#
+# (c) David Haworth
+#
+# dcfclock is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# Usage: tlmdecode.py [file]    (default: stdin, e.g. redirected from the serial port)
+
+import sys
+
+BUTTONS = ('mode', 'up', 'down')
+UI = ('mode++', 'Enter setting', 'Leave setting', 'Switch to off state', 'Switch to normal state',
+	  'Revert to off state', 'Revert to normal state')
+DCF_ERR = '0-+FPZR'
+
+def cobs_decode(frame):
+	out = bytearray()
+	i = 0
+	while i < len(frame):
+		code = frame[i]
+		if code == 0 or i + code > len(frame):
+			return None
+		out += frame[i+1:i+code]
+		i += code
+		if code < 0xff and i < len(frame):
+			out.append(0)
+	return bytes(out)
+
+def describe(id, t, p):
+	if id == 0x01 and len(p) >= 2:
+		text = 'dropped %d' % (p[0] | (p[1] << 8))
+	elif id == 0x10 and len(p) >= 1:
+		text = 'buttons ' + (' '.join(b for i, b in enumerate(BUTTONS) if p[0] & (1 << i)) or 'released')
+	elif id == 0x11 and len(p) >= 1:
+		text = UI[p[0]] if p[0] < len(UI) else 'ui %d' % p[0]
+	elif id == 0x20 and len(p) >= 2:
+		text = 'DCF %s%d' % (DCF_ERR[p[0]] if p[0] < len(DCF_ERR) else '?', p[1])
+		if len(p) >= 3 and p[2] != 0:
+			text += ' lost %d' % p[2]
+	else:
+		text = 'id %02x %s' % (id, p.hex())
+	return '%5d %s' % (t, text)
+
+def main():
+	f = open(sys.argv[1], 'rb') if len(sys.argv) > 1 else sys.stdin.buffer
+	frame = bytearray()
+	line, line_t = '', 0				# TLM_TEXT records of an unfinished line
+	while True:
+		b = f.read(1)
+		if not b:
+			break
+		if b[0] != 0:
+			frame += b
+			continue
+		if frame:
+			rec = cobs_decode(frame)
+			if rec is None:
+				print('bad frame ' + frame.hex(), flush=True)
+			elif len(rec) < 3:
+				print('short record ' + rec.hex(), flush=True)
+			elif rec[0] == 0x02:
+				if not line:
+					line_t = rec[1] | (rec[2] << 8)
+				line += rec[3:].decode('ascii', 'replace')
+				if line.endswith('\n'):
+					print('%5d %s' % (line_t, line.rstrip('\r\n')), flush=True)
+					line = ''
+			else:
+				print(describe(rec[0], rec[1] | (rec[2] << 8), rec[3:]), flush=True)
+		frame = bytearray()
+
+if __name__ == '__main__':
+	main()